@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+struct AutoscalePolicy
+{
+    size_t min_workers;
+    size_t max_workers;
+
+    std::chrono::milliseconds interval = std::chrono::milliseconds(100);
+
+    // waiting elements per worker which count as a backlog
+    size_t depth_per_worker = 4;
+
+    // busy share of the workers' time, growing needs more than high,
+    // shrinking needs less than low and an empty queue
+    double high_utilization = 0.75;
+    double low_utilization  = 0.25;
+
+    // consecutive intervals voting for a change before it is made
+    size_t up_intervals   = 2;
+    size_t down_intervals = 10;
+};
+
+/// Measurements of the manager over the last interval
+struct AutoscaleSample
+{
+    size_t workers;
+    size_t depth;
+    double utilization;
+    double wait_ms;      // mean time elements waited in the queue
+};
+
+/// Decides the number of workers: grows while there is a backlog or
+/// the queue wait time rises and the workers are busy, shrinks while
+/// they are mostly idle; the gap between the thresholds and the vote
+/// counts give hysteresis, so a short spike does not cause flapping
+class Autoscaler
+{
+ public:
+    explicit Autoscaler(AutoscalePolicy policy);
+
+    /// Returns the number of workers for the next interval
+    size_t decide(const AutoscaleSample& sample);
+
+    const AutoscalePolicy& policy() const;
+
+ private:
+    AutoscalePolicy policy_;
+    double          wait_average_;
+    size_t          up_votes_;
+    size_t          down_votes_;
+};
+
+inline Autoscaler::Autoscaler(AutoscalePolicy policy)
+    : policy_(policy),
+      wait_average_(0),
+      up_votes_(0),
+      down_votes_(0)
+{
+    policy_.min_workers = std::max<size_t>(policy_.min_workers, 1);
+    policy_.max_workers = std::max(policy_.max_workers, policy_.min_workers);
+}
+
+inline const AutoscalePolicy& Autoscaler::policy() const
+{ return policy_; }
+
+inline size_t Autoscaler::decide(const AutoscaleSample& sample)
+{
+    bool backlog = sample.depth > sample.workers * policy_.depth_per_worker;
+    bool slower = wait_average_ > 0 && sample.wait_ms > wait_average_ * 1.25;
+    wait_average_ = 0.8 * wait_average_ + 0.2 * sample.wait_ms;
+
+    if ((backlog || slower) && sample.utilization >= policy_.high_utilization) {
+        ++up_votes_;
+        down_votes_ = 0;
+    } else if (sample.depth == 0 && sample.utilization <= policy_.low_utilization) {
+        ++down_votes_;
+        up_votes_ = 0;
+    } else {
+        up_votes_ = down_votes_ = 0;
+    }
+
+    size_t workers = std::clamp(sample.workers, policy_.min_workers, policy_.max_workers);
+
+    // grow by half the pool at once to catch up with bursts,
+    // shrink one by one
+    if (up_votes_ >= policy_.up_intervals) {
+        up_votes_ = 0;
+        return std::min(workers + std::max<size_t>(workers / 2, 1), policy_.max_workers);
+    }
+    if (down_votes_ >= policy_.down_intervals) {
+        down_votes_ = 0;
+        return std::max(workers - 1, policy_.min_workers);
+    }
+    return workers;
+}
+
+}
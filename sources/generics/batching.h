@@ -0,0 +1,97 @@
+#pragma once
+
+#include <algorithm>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+struct BatchPolicy
+{
+    size_t                    max_batch = 64;
+    std::chrono::microseconds max_linger = std::chrono::microseconds(1000);
+
+    // the 99th percentile of the time from receipt to completion
+    // is kept under this while batches grow
+    std::chrono::milliseconds p99_target = std::chrono::milliseconds(50);
+
+    std::chrono::milliseconds interval = std::chrono::milliseconds(50);
+};
+
+/// Measurements of the manager over the last interval
+struct BatchSample
+{
+    double arrival_rate;  // elements per second
+    size_t depth;         // waiting elements
+    double service_us;    // handler time per element
+    double p99_ms;        // receipt to completion, 0 if none completed
+};
+
+struct BatchDecision
+{
+    size_t                    batch;
+    std::chrono::microseconds linger;  // wait to fill a batch
+};
+
+/// Decides how many waiting elements a worker takes at once and how
+/// long it waits for more to fill the batch. Batches double while
+/// there is a backlog and the p99 latency leaves room for one more
+/// batch's service time, and halve when the p99 is over the target.
+/// Lingering is limited to the time the arrival rate needs to fill
+/// the batch and to half the latency headroom, so a quiet system or
+/// one over its target does not wait at all
+class BatchController
+{
+ public:
+    explicit BatchController(BatchPolicy policy);
+
+    /// Returns the batch size and linger for the next interval
+    BatchDecision decide(const BatchSample& sample);
+
+    const BatchPolicy& policy() const;
+
+ private:
+    BatchPolicy policy_;
+    size_t      batch_;
+};
+
+inline BatchController::BatchController(BatchPolicy policy)
+    : policy_(policy),
+      batch_(1)
+{ policy_.max_batch = std::max<size_t>(policy_.max_batch, 1); }
+
+inline const BatchPolicy& BatchController::policy() const
+{ return policy_; }
+
+inline BatchDecision BatchController::decide(const BatchSample& sample)
+{
+    double target_ms = static_cast<double>(policy_.p99_target.count());
+    double headroom_ms = target_ms - sample.p99_ms;
+
+    if (headroom_ms < 0) {
+        batch_ = std::max<size_t>(batch_ / 2, 1);
+    } else if (sample.depth > batch_
+               && 2 * batch_ * sample.service_us / 1000 < headroom_ms) {
+        batch_ = std::min(2 * batch_, policy_.max_batch);
+    }
+
+    double linger_us = 0;
+    if (batch_ > 1 && headroom_ms > 0 && sample.arrival_rate > 0) {
+        double fill_us = static_cast<double>(batch_ - 1) / sample.arrival_rate * 1e6;
+        linger_us = std::min({
+            fill_us,
+            headroom_ms * 1000 / 2,
+            static_cast<double>(policy_.max_linger.count())
+        });
+
+        // not even one more element is expected meanwhile
+        if (sample.arrival_rate * linger_us / 1e6 < 1) {
+            linger_us = 0;
+        }
+    }
+
+    return BatchDecision{batch_, std::chrono::microseconds(static_cast<int64_t>(linger_us))};
+}
+
+}
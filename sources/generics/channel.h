@@ -0,0 +1,106 @@
+#pragma once
+
+#include "queue.h"
+#include "gendef.h"
+#include "resource.h"
+
+namespace gen
+{
+
+/// Bounded blocking queue which can be used as a Resource.
+/// push() waits while the channel is full, so a slow consumer
+/// throttles its producers instead of growing the buffer.
+template <class T>
+class Channel final : public Resource<T>
+{
+ public:
+    using data_t = T;
+
+    explicit Channel(size_t capacity);
+    ~Channel() override = default;
+
+    Channel() = delete;
+    Channel(const Channel&) = delete;
+
+    void push(data_t&& x);
+
+    data_t get_data() override;
+    bool is_empty() override;
+
+    size_t size() const noexcept;
+    size_t max_size() const noexcept;
+
+    /// Number of push() calls which had to wait for free space
+    uint64_t blocked_pushes() const noexcept;
+
+    /// Moves all waiting elements to the back of backup
+    void move_to(Queue<T>& backup);
+
+ private:
+    Queue<data_t> queue_;
+    size_t        capacity_;
+
+    mutable mutex_t mutex_;
+    cond_var_t      cv_put_;
+
+    std::atomic<uint64_t> blocked_pushes_;
+};
+
+template <class T>
+Channel<T>::Channel(size_t capacity)
+    : queue_(capacity),
+      capacity_(capacity ? capacity : 1),
+      blocked_pushes_(0)
+{ name_lock(mutex_, "channel"); }
+
+template <class T>
+void Channel<T>::push(data_t&& x)
+{
+    lock_t lock(mutex_);
+    if (queue_.size() >= capacity_) {
+        blocked_pushes_.fetch_add(1, std::memory_order_relaxed);
+        cv_put_.wait(lock, [&] { return queue_.size() < capacity_; });
+    }
+    queue_.emplace(std::move(x));
+}
+
+template <class T>
+T Channel<T>::get_data()
+{
+    lock_t lock(mutex_);
+    data_t value = queue_.take_first();
+    lock.unlock();
+
+    cv_put_.notify_one();
+    return value;
+}
+
+template <class T>
+bool Channel<T>::is_empty()
+{ return queue_.empty(); }
+
+template <class T>
+size_t Channel<T>::size() const noexcept
+{ return queue_.size(); }
+
+template <class T>
+size_t Channel<T>::max_size() const noexcept
+{ return capacity_; }
+
+template <class T>
+uint64_t Channel<T>::blocked_pushes() const noexcept
+{ return blocked_pushes_.load(std::memory_order_relaxed); }
+
+template <class T>
+void Channel<T>::move_to(Queue<T>& backup)
+{
+    lock_t lock(mutex_);
+    while (!queue_.empty()) {
+        backup.emplace(queue_.take_first());
+    }
+    lock.unlock();
+
+    cv_put_.notify_all();
+}
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+
+#include "gendef.h"
+#include "sharded_map.h"
+
+namespace gen
+{
+
+/// Merges elements with equal keys while they are waiting in a queue.
+/// The first element of a key (the leader) is queued, later ones are
+/// kept aside as followers until the leader is taken for processing.
+template <class T>
+class Coalescer
+{
+ public:
+    virtual ~Coalescer() = default;
+
+    /// Returns true if x has been attached to a waiting leader,
+    /// in which case it must not be queued
+    virtual bool try_merge(T& x) = 0;
+
+    /// Forgets the key of the leader and returns its followers
+    virtual std::vector<T> release(const T& leader) = 0;
+
+    /// Passes a follower whose leader has been processed to the user
+    virtual void fan_out(T&& follower) = 0;
+
+    /// Passes all followers to sink and forgets all keys
+    virtual void drain(const std::function<void(T&&)>& sink) = 0;
+};
+
+template <class T, class KeyOf, class OnMerged>
+class KeyedCoalescer final : public Coalescer<T>
+{
+ public:
+    using key_t = std::remove_cvref_t<std::invoke_result_t<KeyOf&, const T&>>;
+
+    KeyedCoalescer(KeyOf key_of, OnMerged on_merged);
+
+    bool try_merge(T& x) override;
+    std::vector<T> release(const T& leader) override;
+    void fan_out(T&& follower) override;
+    void drain(const std::function<void(T&&)>& sink) override;
+
+ private:
+    KeyOf    key_of_;
+    OnMerged on_merged_;
+
+    ShardedMap<key_t, std::vector<T>> pending_;
+};
+
+template <class T, class KeyOf, class OnMerged>
+KeyedCoalescer<T, KeyOf, OnMerged>::KeyedCoalescer(KeyOf key_of, OnMerged on_merged)
+    : key_of_(std::move(key_of)),
+      on_merged_(std::move(on_merged))
+{ }
+
+template <class T, class KeyOf, class OnMerged>
+bool KeyedCoalescer<T, KeyOf, OnMerged>::try_merge(T& x)
+{
+    key_t key = key_of_(x);
+    return pending_.apply(key, [&](auto& map) {
+        auto it = map.find(key);
+        if (it == map.end()) {
+            map.emplace(std::move(key), std::vector<T>());
+            return false;
+        }
+        it->second.push_back(std::move(x));
+        return true;
+    });
+}
+
+template <class T, class KeyOf, class OnMerged>
+std::vector<T> KeyedCoalescer<T, KeyOf, OnMerged>::release(const T& leader)
+{
+    key_t key = key_of_(leader);
+    return pending_.apply(key, [&](auto& map) {
+        std::vector<T> followers;
+        auto it = map.find(key);
+        if (it != map.end()) {
+            followers.swap(it->second);
+            map.erase(it);
+        }
+        return followers;
+    });
+}
+
+template <class T, class KeyOf, class OnMerged>
+void KeyedCoalescer<T, KeyOf, OnMerged>::fan_out(T&& follower)
+{ on_merged_(std::move(follower)); }
+
+template <class T, class KeyOf, class OnMerged>
+void KeyedCoalescer<T, KeyOf, OnMerged>::drain(const std::function<void(T&&)>& sink)
+{
+    pending_.for_each_shard([&](auto& map) {
+        for (auto& [key, followers] : map) {
+            for (auto& x : followers) {
+                sink(std::move(x));
+            }
+        }
+        map.clear();
+    });
+}
+
+}
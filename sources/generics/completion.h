@@ -0,0 +1,259 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <variant>
+
+#include "gendef.h"
+#include "slab.h"
+
+// Declarations
+namespace gen
+{
+
+template <class R>
+using stored_result_t = std::conditional_t<std::is_void_v<R>, std::monostate, R>;
+
+enum CompletionState : uint32_t
+{
+    COMPLETION_PENDING,
+    COMPLETION_HOOKED,   // pending, callback is set
+    COMPLETION_DONE,
+    COMPLETION_DROPPED   // element left the manager without processing
+};
+
+template <class R>
+struct CompletionSlot
+{
+    using value_t = stored_result_t<R>;
+    using callback_t = std::function<void(value_t*)>;
+
+    std::atomic<uint32_t> state{COMPLETION_PENDING};
+    std::atomic<uint32_t> refs{0};
+
+    std::optional<value_t> result;
+    callback_t             callback;
+};
+
+template <class R>
+class CompletionPool;
+
+/// Handle to the result of a submitted element. Slots are taken
+/// from a slab owned by the manager, so a handle must not outlive it.
+template <class R>
+class Completion
+{
+ public:
+    using value_t = stored_result_t<R>;
+
+    Completion() noexcept;
+    ~Completion();
+
+    Completion(Completion&& src) noexcept;
+    Completion& operator=(Completion&& rhs) noexcept;
+
+    Completion(const Completion&) = delete;
+    Completion& operator=(const Completion&) = delete;
+
+    /// False for a default-constructed handle or if the slab is exhausted
+    bool valid() const noexcept;
+
+    /// True if the element has been processed or dropped
+    bool ready() const noexcept;
+
+    /// True if the element left the manager unprocessed
+    /// (saved to a backup or discarded on stop)
+    bool dropped() const noexcept;
+
+    void wait() const noexcept;
+
+    /// Waits and returns the result; the handle must not be dropped()
+    R get();
+
+    /// callback(&result) is called by the worker after processing,
+    /// callback(nullptr) if the element is dropped; called at once
+    /// if the handle is already ready()
+    template <class F>
+    void then(F&& callback);
+
+ private:
+    friend class CompletionPool<R>;
+
+    using index_t = typename Slab<CompletionSlot<R>>::index_t;
+
+    CompletionPool<R>* pool_;
+    index_t            index_;
+
+    Completion(CompletionPool<R>* pool, index_t index) noexcept;
+
+    CompletionSlot<R>& slot_() const noexcept;
+};
+
+template <class R>
+class CompletionPool
+{
+ public:
+    using index_t = typename Slab<CompletionSlot<R>>::index_t;
+    using value_t = stored_result_t<R>;
+
+    static constexpr index_t NONE = Slab<CompletionSlot<R>>::NONE;
+
+    /// Takes a slot shared by the returned handle and
+    /// the owner of index, who must complete or drop it
+    Completion<R> open(index_t& index);
+
+    void complete(index_t index, value_t&& value);
+    void drop(index_t index);
+
+ private:
+    friend class Completion<R>;
+
+    Slab<CompletionSlot<R>> slots_;
+
+    void finish_(index_t index, uint32_t state);
+    void unref_(index_t index) noexcept;
+};
+
+}
+
+// Definitions
+namespace gen
+{
+
+template <class R>
+Completion<R>::Completion() noexcept
+    : pool_(nullptr),
+      index_(CompletionPool<R>::NONE)
+{ }
+
+template <class R>
+Completion<R>::Completion(CompletionPool<R>* pool, index_t index) noexcept
+    : pool_(pool),
+      index_(index)
+{ }
+
+template <class R>
+Completion<R>::~Completion()
+{
+    if (pool_) {
+        pool_->unref_(index_);
+    }
+}
+
+template <class R>
+Completion<R>::Completion(Completion&& src) noexcept
+    : pool_(src.pool_),
+      index_(src.index_)
+{ src.pool_ = nullptr; }
+
+template <class R>
+Completion<R>& Completion<R>::operator=(Completion&& rhs) noexcept
+{
+    if (this != &rhs) {
+        if (pool_) {
+            pool_->unref_(index_);
+        }
+        pool_ = rhs.pool_;
+        index_ = rhs.index_;
+        rhs.pool_ = nullptr;
+    }
+    return *this;
+}
+
+template <class R>
+CompletionSlot<R>& Completion<R>::slot_() const noexcept
+{ return pool_->slots_[index_]; }
+
+template <class R>
+bool Completion<R>::valid() const noexcept
+{ return pool_ != nullptr; }
+
+template <class R>
+bool Completion<R>::ready() const noexcept
+{ return slot_().state.load(std::memory_order_acquire) >= COMPLETION_DONE; }
+
+template <class R>
+bool Completion<R>::dropped() const noexcept
+{ return slot_().state.load(std::memory_order_acquire) == COMPLETION_DROPPED; }
+
+template <class R>
+void Completion<R>::wait() const noexcept
+{
+    auto& state = slot_().state;
+    uint32_t current = state.load(std::memory_order_acquire);
+    while (current < COMPLETION_DONE) {
+        state.wait(current, std::memory_order_acquire);
+        current = state.load(std::memory_order_acquire);
+    }
+}
+
+template <class R>
+R Completion<R>::get()
+{
+    wait();
+    if constexpr (!std::is_void_v<R>) {
+        return std::move(*slot_().result);
+    }
+}
+
+template <class R>
+template <class F>
+void Completion<R>::then(F&& callback)
+{
+    CompletionSlot<R>& slot = slot_();
+    slot.callback = std::forward<F>(callback);
+
+    uint32_t expected = COMPLETION_PENDING;
+    if (!slot.state.compare_exchange_strong(
+            expected, COMPLETION_HOOKED, std::memory_order_acq_rel)) {
+        slot.callback(expected == COMPLETION_DONE ? &*slot.result : nullptr);
+    }
+}
+
+template <class R>
+Completion<R> CompletionPool<R>::open(index_t& index)
+{
+    index = slots_.acquire();
+    if (index == NONE) {
+        return Completion<R>();
+    }
+    slots_[index].refs.store(2, std::memory_order_relaxed);
+    return Completion<R>(this, index);
+}
+
+template <class R>
+void CompletionPool<R>::complete(index_t index, value_t&& value)
+{
+    slots_[index].result.emplace(std::move(value));
+    finish_(index, COMPLETION_DONE);
+}
+
+template <class R>
+void CompletionPool<R>::drop(index_t index)
+{ finish_(index, COMPLETION_DROPPED); }
+
+template <class R>
+void CompletionPool<R>::finish_(index_t index, uint32_t state)
+{
+    CompletionSlot<R>& slot = slots_[index];
+    uint32_t previous = slot.state.exchange(state, std::memory_order_acq_rel);
+    if (previous == COMPLETION_HOOKED) {
+        slot.callback(state == COMPLETION_DONE ? &*slot.result : nullptr);
+    }
+    slot.state.notify_all();
+    unref_(index);
+}
+
+template <class R>
+void CompletionPool<R>::unref_(index_t index) noexcept
+{
+    CompletionSlot<R>& slot = slots_[index];
+    if (slot.refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        slot.result.reset();
+        slot.callback = nullptr;
+        slot.state.store(COMPLETION_PENDING, std::memory_order_relaxed);
+        slots_.release(index);
+    }
+}
+
+}
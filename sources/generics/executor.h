@@ -0,0 +1,193 @@
+#pragma once
+
+#include <unordered_map>
+#include <memory>
+#include <vector>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+/// Source of work for an executor, e.g. a resource manager
+class Executable
+{
+ public:
+    virtual ~Executable() = default;
+
+    /// Processes one waiting element, returns false if there was none
+    virtual bool run_one() = 0;
+};
+
+/// Runs the work of attached sources on threads it owns
+class Executor
+{
+ public:
+    virtual ~Executor() = default;
+
+    /// At most max_concurrency runs of source are in progress at once
+    virtual void attach(Executable& source, size_t max_concurrency) = 0;
+
+    /// Stops running source and waits for its runs in progress
+    virtual void detach(Executable& source) = 0;
+
+    /// Source may have work to run
+    virtual void notify(Executable& source) = 0;
+};
+
+/// Thread pool shared by many sources: an idle thread takes the next
+/// source in round-robin order which has work and is below its cap,
+/// runs one element of it and moves on, so sources share the threads
+/// fairly regardless of their queue lengths
+class ThreadPoolExecutor final : public Executor
+{
+ public:
+    explicit ThreadPoolExecutor(size_t n_of_threads);
+    ~ThreadPoolExecutor() override;
+
+    ThreadPoolExecutor(const ThreadPoolExecutor&) = delete;
+
+    void attach(Executable& source, size_t max_concurrency) override;
+    void detach(Executable& source) override;
+    void notify(Executable& source) override;
+
+    size_t n_of_threads() const;
+
+ private:
+    struct Entry
+    {
+        Executable* source;
+        size_t      max_concurrency;
+        size_t      running;
+
+        // the source has work while notified differs from seen
+        uint64_t    notified;
+        uint64_t    seen;
+    };
+
+    using entries_t = std::unordered_map<Executable*, std::unique_ptr<Entry>>;
+
+    entries_t           entries_;
+    std::vector<Entry*> order_;
+    size_t              cursor_;
+    bool                stopping_;
+
+    mutex_t    mutex_;
+    cond_var_t cv_work_;
+    cond_var_t cv_idle_;
+
+    std::vector<thread_t> threads_;
+
+    void work_();
+    Entry* pick_();
+};
+
+inline ThreadPoolExecutor::ThreadPoolExecutor(size_t n_of_threads)
+    : cursor_(0),
+      stopping_(false)
+{
+    name_lock(mutex_, "executor");
+    threads_.reserve(n_of_threads);
+    for (size_t i = 0; i < n_of_threads; ++i) {
+        threads_.emplace_back([this] { work_(); });
+    }
+}
+
+inline ThreadPoolExecutor::~ThreadPoolExecutor()
+{
+    {
+        lock_t lock(mutex_);
+        stopping_ = true;
+    }
+    cv_work_.notify_all();
+    threads_.clear();
+}
+
+inline size_t ThreadPoolExecutor::n_of_threads() const
+{ return threads_.size(); }
+
+inline void ThreadPoolExecutor::attach(Executable& source, size_t max_concurrency)
+{
+    lock_t lock(mutex_);
+    auto entry = std::make_unique<Entry>(Entry{
+        &source, max_concurrency ? max_concurrency : 1, 0, 1, 0
+    });
+    order_.push_back(entry.get());
+    entries_[&source] = std::move(entry);
+    lock.unlock();
+
+    cv_work_.notify_all();
+}
+
+inline void ThreadPoolExecutor::detach(Executable& source)
+{
+    lock_t lock(mutex_);
+    auto it = entries_.find(&source);
+    if (it == entries_.end()) {
+        return;
+    }
+
+    Entry* entry = it->second.get();
+    for (size_t i = 0; i < order_.size(); ++i) {
+        if (order_[i] == entry) {
+            order_.erase(order_.begin() + i);
+            break;
+        }
+    }
+    cv_idle_.wait(lock, [&] { return entry->running == 0; });
+    entries_.erase(it);
+}
+
+inline void ThreadPoolExecutor::notify(Executable& source)
+{
+    lock_t lock(mutex_);
+    auto it = entries_.find(&source);
+    if (it == entries_.end()) {
+        return;
+    }
+    ++it->second->notified;
+    lock.unlock();
+
+    cv_work_.notify_one();
+}
+
+inline ThreadPoolExecutor::Entry* ThreadPoolExecutor::pick_()
+{
+    for (size_t i = 0; i < order_.size(); ++i) {
+        Entry* entry = order_[(cursor_ + i) % order_.size()];
+        if (entry->notified != entry->seen && entry->running < entry->max_concurrency) {
+            cursor_ = (cursor_ + i + 1) % order_.size();
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+inline void ThreadPoolExecutor::work_()
+{
+    lock_t lock(mutex_);
+    while (true) {
+        Entry* entry = nullptr;
+        cv_work_.wait(lock, [&] { return stopping_ || (entry = pick_()); });
+        if (stopping_) {
+            break;
+        }
+
+        ++entry->running;
+        uint64_t notified = entry->notified;
+        lock.unlock();
+
+        bool done = entry->source->run_one();
+
+        lock.lock();
+        --entry->running;
+        if (!done && entry->notified == notified) {
+            entry->seen = notified;
+        }
+        if (entry->running == 0) {
+            cv_idle_.notify_all();
+        }
+    }
+}
+
+}
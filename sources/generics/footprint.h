@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+/// Memory held by an element: sizeof(T) plus x.footprint() if T has
+/// one; specialize it for types which own heap memory and cannot
+/// have the member
+template <class T>
+struct Footprint
+{
+    size_t operator()(const T& x) const
+    {
+        if constexpr (requires { { x.footprint() } -> std::convertible_to<size_t>; }) {
+            return sizeof(T) + x.footprint();
+        } else {
+            return sizeof(T);
+        }
+    }
+};
+
+template <class C, class Traits, class Alloc>
+struct Footprint<std::basic_string<C, Traits, Alloc>>
+{
+    size_t operator()(const std::basic_string<C, Traits, Alloc>& x) const
+    { return sizeof(x) + x.capacity() * sizeof(C); }
+};
+
+template <class T, class Alloc>
+struct Footprint<std::vector<T, Alloc>>
+{
+    size_t operator()(const std::vector<T, Alloc>& x) const
+    {
+        size_t bytes = sizeof(x) + (x.capacity() - x.size()) * sizeof(T);
+        for (const auto& item : x) {
+            bytes += Footprint<T>()(item);
+        }
+        return bytes;
+    }
+};
+
+}
@@ -1,34 +1,125 @@
-#pragma once
-
-#include <condition_variable>
-#include <functional>
-#include <atomic>
-#include <future>
-#include <thread>
-#include <mutex>
-
-#include "genexcept.h"
-
-namespace gen
-{
-using cond_var_t = std::condition_variable;
-using thread_t = std::thread;
-using mutex_t = std::mutex;
-using lock_t = std::unique_lock<mutex_t>;
-
-template <class T>
-class Resource;
-
-template <class T>
-class DataHandler;
-
-template <class T>
-class ResourceManager;
-
-enum Status
-{
-    STATUS_RUNNING,
-    STATUS_STOPPED
-};
-
-}
+#pragma once
+
+#include <condition_variable>
+#include <type_traits>
+#include <functional>
+#include <concepts>
+#include <stop_token>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+#include <mutex>
+
+#include "genexcept.h"
+
+#ifdef __LOCK_PROFILING__
+#include "lock_profiler.h"
+#endif  // __LOCK_PROFILING__
+
+namespace gen
+{
+using thread_t = std::jthread;
+
+#ifdef __LOCK_PROFILING__
+using cond_var_t = ProfiledCondVar;
+using mutex_t = ProfiledMutex;
+#else
+using cond_var_t = std::condition_variable;
+using mutex_t = std::mutex;
+#endif  // __LOCK_PROFILING__
+
+using lock_t = std::unique_lock<mutex_t>;
+
+/// Groups the mutex under name in the lock profiler report,
+/// does nothing unless __LOCK_PROFILING__ is defined
+inline void name_lock([[maybe_unused]] mutex_t& mutex, [[maybe_unused]] const char* name)
+{
+#ifdef __LOCK_PROFILING__
+    mutex.set_name(name);
+#endif  // __LOCK_PROFILING__
+}
+
+template <class T>
+class Resource;
+
+template <class T, class R = void>
+class DataHandler;
+
+template <class T, class R = void>
+class ResourceManager;
+
+/// Anything with get_data() and is_empty(), not necessarily a Resource<T>
+template <class R>
+concept ResourceLike = requires(R& r)
+{
+    { r.is_empty() } -> std::convertible_to<bool>;
+    r.get_data();
+};
+
+template <class R>
+using resource_data_t = std::remove_cvref_t<decltype(std::declval<R&>().get_data())>;
+
+/// Anything with process(T&&), not necessarily a DataHandler<T>
+template <class H, class T>
+concept HandlerFor = requires(H& h, T&& data)
+{
+    h.process(std::move(data));
+};
+
+/// Handler which accepts a stop token along with the data
+template <class H, class T>
+concept CancellableHandlerFor = requires(H& h, T&& data, std::stop_token token)
+{
+    h.process(std::move(data), token);
+};
+
+/// Handler which also takes many elements in one call and returns
+/// their results in order, a std::vector unless they are void
+template <class H, class T>
+concept BatchHandlerFor = requires(H& h, std::vector<T>&& batch)
+{
+    h.process_batch(std::move(batch));
+};
+
+template <class H, class T>
+using handler_result_t = decltype(std::declval<H&>().process(std::declval<T&&>()));
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+class BasicResourceManager;
+
+enum Status
+{
+    STATUS_RUNNING,
+    STATUS_DRAINING,
+    STATUS_STOPPED
+};
+
+enum StopMode
+{
+    STOP_IMMEDIATE,       // cancel handlers in flight
+    STOP_DRAIN,           // process all waiting elements first
+    STOP_DRAIN_DEADLINE   // drain until the deadline, then cancel
+};
+
+enum LimitPoint
+{
+    LIMIT_AT_INGESTION,   // before an element is queued
+    LIMIT_AT_DISPATCH     // before an element is handled
+};
+
+enum OverLimit
+{
+    OVER_LIMIT_REJECT,    // drop the element
+    OVER_LIMIT_DELAY,     // wait until a token is available
+    OVER_LIMIT_OVERFLOW   // pass the element to the overflow callback
+};
+
+enum WaitStrategy
+{
+    WAIT_BLOCK,           // sleep on a condition variable
+    WAIT_SPIN_PARK        // spin, then yield, then park on a futex
+};
+
+}
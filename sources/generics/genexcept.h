@@ -33,4 +33,21 @@ class UnsavedDataLeak : public std::runtime_error
 
 }
 
-#endif  // __INFO_DEBUG__
\ No newline at end of file
+#endif  // __INFO_DEBUG__
+
+#include <exception>
+
+namespace gen
+{
+
+/// Thrown by a handler which gives up an element because its stop
+/// token has been triggered; the element must be left unconsumed,
+/// the manager puts it back to be saved or processed later
+class OperationCancelled : public std::exception
+{
+ public:
+    const char* what() const noexcept override
+    { return "Operation cancelled"; }
+};
+
+}
@@ -1,21 +1,27 @@
-#pragma once
-
-#include "gendef.h"
-
-namespace gen
-{
-
-template <class T>
-class DataHandler
-{
- public:
-    using data_t = T;
-
-    DataHandler() = default;
-    DataHandler(const DataHandler&) = default;
-
-    virtual void process(data_t&& data) = 0;
-    virtual ~DataHandler() = default;
-};
-
+#pragma once
+
+#include "gendef.h"
+
+namespace gen
+{
+
+template <class T, class R>
+class DataHandler
+{
+ public:
+    using data_t = T;
+    using result_t = R;
+
+    DataHandler() = default;
+    DataHandler(const DataHandler&) = default;
+
+    virtual result_t process(data_t&& data) = 0;
+
+    /// Called by the manager; override it to react to stop requests
+    /// and throw OperationCancelled without consuming data
+    virtual result_t process(data_t&& data, std::stop_token)
+    { return process(std::move(data)); }
+    virtual ~DataHandler() = default;
+};
+
 }
\ No newline at end of file
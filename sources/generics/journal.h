@@ -0,0 +1,537 @@
+#pragma once
+
+#include <system_error>
+#include <type_traits>
+#include <string_view>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <map>
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+struct JournalOptions
+{
+    size_t segment_bytes = size_t(64) << 20;
+
+    // group commit: buffered records are written and synced when
+    // batch_bytes are buffered or batch_interval has passed
+    size_t                    batch_bytes = size_t(1) << 20;
+    std::chrono::milliseconds batch_interval = std::chrono::milliseconds(5);
+
+    // the accepting thread waits until its element is on disk;
+    // otherwise a crash loses at most the last batch_interval
+    bool wait_for_sync = false;
+};
+
+/// Bytes of an element in the journal, specialize for own types
+template <class T>
+struct JournalCodec;
+
+template <class T>
+    requires std::is_trivially_copyable_v<T>
+struct JournalCodec<T>
+{
+    static void encode(const T& x, std::string& out)
+    { out.append(reinterpret_cast<const char*>(&x), sizeof(T)); }
+
+    static T decode(std::string_view bytes)
+    {
+        T x;
+        std::memcpy(&x, bytes.data(), std::min(bytes.size(), sizeof(T)));
+        return x;
+    }
+};
+
+template <>
+struct JournalCodec<std::string>
+{
+    static void encode(const std::string& x, std::string& out)
+    { out.append(x); }
+
+    static std::string decode(std::string_view bytes)
+    { return std::string(bytes); }
+};
+
+/// Write-ahead journal of accepted elements in numbered segment files.
+/// append() buffers a record and returns its sequence number, a flusher
+/// thread writes and fdatasync()s the buffer in batches, ack() marks
+/// an element as finished. Segments whose elements are all acked are
+/// deleted oldest first; on open, the records of the remaining ones
+/// which have no ack are kept for replay(). Records carry a CRC, so a
+/// torn tail left by a crash ends the scan of its segment. A failed
+/// write or sync is sticky: nothing after it counts as durable and
+/// append(), wait_durable() and sync() throw std::system_error
+class Journal
+{
+ public:
+    Journal(std::string dir, JournalOptions options);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+
+    /// Calls f(seq, payload) for each element not acked when the
+    /// journal was opened, in order; once, before appending
+    template <class F>
+    void replay(F f);
+
+    uint64_t append(std::string_view payload);
+    void     ack(uint64_t seq);
+
+    /// Waits until the record of seq is on disk
+    void wait_durable(uint64_t seq);
+    void sync();
+
+    const JournalOptions& options() const;
+
+    /// The first failed write or sync, empty while there is none
+    std::error_code error() const;
+
+    uint64_t syncs() const;
+    size_t   segments() const;
+
+ private:
+    enum RecordType : uint8_t
+    {
+        RECORD_ELEMENT = 1,
+        RECORD_ACK = 2
+    };
+
+    // length, crc, type, seq
+    static constexpr size_t HEADER_SIZE = 4 + 4 + 1 + 8;
+
+    struct Segment
+    {
+        uint64_t id;
+        uint64_t first_seq;
+        size_t   pending;  // elements not acked
+        size_t   bytes;
+    };
+
+    struct Chunk
+    {
+        uint64_t    segment;
+        std::string bytes;
+    };
+
+    const std::string    dir_;
+    const JournalOptions options_;
+
+    mutable mutex_t mutex_;
+    cond_var_t      cv_flush_;
+    cond_var_t      cv_durable_;
+
+    std::deque<Segment> segments_;   // by id, the last one takes appends
+    std::vector<Chunk>  buffer_;
+    size_t              buffered_;
+    uint64_t            next_seq_;
+    uint64_t            durable_seq_;
+    uint64_t            sync_requests_;
+    uint64_t            syncs_done_;   // requests served by a finished flush
+    bool                stopping_;
+    int                 error_;        // errno of the first failure, sticky
+    std::atomic<uint64_t> syncs_;
+
+    std::map<uint64_t, std::string> unacked_;  // found on open
+
+    int      fd_;           // flusher only
+    uint64_t open_segment_;
+
+    thread_t flusher_;
+
+    void scan_();
+    void flush_();
+    int  write_(std::vector<Chunk>& chunks);
+    void throw_if_failed_() const;
+    void record_(RecordType type, uint64_t seq, std::string_view payload);
+    Segment* segment_of_(uint64_t seq);
+    std::string path_(uint64_t id) const;
+
+    static uint32_t crc32_(const char* data, size_t size, uint32_t crc = 0);
+};
+
+inline Journal::Journal(std::string dir, JournalOptions options)
+    : dir_(std::move(dir)),
+      options_(options),
+      buffered_(0),
+      next_seq_(1),
+      durable_seq_(0),
+      sync_requests_(0),
+      syncs_done_(0),
+      stopping_(false),
+      error_(0),
+      syncs_(0),
+      fd_(-1),
+      open_segment_(0)
+{
+    name_lock(mutex_, "journal");
+    if (mkdir(dir_.c_str(), 0700) != 0 && errno != EEXIST) {
+        throw std::system_error(errno, std::generic_category(), "mkdir " + dir_);
+    }
+    scan_();
+    durable_seq_ = next_seq_ - 1;
+
+    // appends start a new segment, a torn tail is never extended
+    uint64_t id = segments_.empty() ? 1 : segments_.back().id + 1;
+    segments_.push_back(Segment{id, next_seq_, 0, 0});
+
+    flusher_ = thread_t([this] { flush_(); });
+}
+
+inline Journal::~Journal()
+{
+    {
+        lock_t lock(mutex_);
+        stopping_ = true;
+    }
+    cv_flush_.notify_all();
+    flusher_.join();
+
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+inline std::string Journal::path_(uint64_t id) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%010llu.wal", static_cast<unsigned long long>(id));
+    return dir_ + name;
+}
+
+inline uint32_t Journal::crc32_(const char* data, size_t size, uint32_t crc)
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            t[i] = c;
+        }
+        return t;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline void Journal::scan_()
+{
+    std::vector<uint64_t> ids;
+    if (DIR* d = opendir(dir_.c_str())) {
+        while (dirent* e = readdir(d)) {
+            unsigned long long id;
+            char tail[8];
+            if (std::sscanf(e->d_name, "%llu.%7s", &id, tail) == 2 && std::strcmp(tail, "wal") == 0) {
+                ids.push_back(id);
+            }
+        }
+        closedir(d);
+    }
+    std::sort(ids.begin(), ids.end());
+
+    std::map<uint64_t, uint64_t> segment_of;  // unacked seq -> segment id
+    for (uint64_t id : ids) {
+        std::string bytes;
+        if (FILE* f = std::fopen(path_(id).c_str(), "rb")) {
+            char block[1 << 16];
+            size_t n;
+            while ((n = std::fread(block, 1, sizeof(block), f)) > 0) {
+                bytes.append(block, n);
+            }
+            std::fclose(f);
+        }
+
+        Segment segment{id, next_seq_, 0, bytes.size()};
+        size_t pos = 0;
+        while (pos + HEADER_SIZE <= bytes.size()) {
+            uint32_t length, crc;
+            uint64_t seq;
+            std::memcpy(&length, bytes.data() + pos, 4);
+            std::memcpy(&crc, bytes.data() + pos + 4, 4);
+            auto type = static_cast<uint8_t>(bytes[pos + 8]);
+            std::memcpy(&seq, bytes.data() + pos + 9, 8);
+
+            if (pos + HEADER_SIZE + length > bytes.size()
+                || crc32_(bytes.data() + pos + 8, 9 + length) != crc) {
+                break;
+            }
+
+            if (type == RECORD_ELEMENT) {
+                unacked_.emplace(seq, bytes.substr(pos + HEADER_SIZE, length));
+                segment_of[seq] = id;
+                segment.first_seq = std::min(segment.first_seq, seq);
+            } else if (type == RECORD_ACK) {
+                unacked_.erase(seq);
+                segment_of.erase(seq);
+            }
+            next_seq_ = std::max(next_seq_, seq + 1);
+            pos += HEADER_SIZE + length;
+        }
+        segments_.push_back(segment);
+    }
+
+    for (auto& [seq, id] : segment_of) {
+        auto it = std::find_if(segments_.begin(), segments_.end(), [&](const Segment& s) {
+            return s.id == id;
+        });
+        ++it->pending;
+    }
+
+    while (!segments_.empty() && segments_.front().pending == 0) {
+        ::unlink(path_(segments_.front().id).c_str());
+        segments_.pop_front();
+    }
+}
+
+template <class F>
+void Journal::replay(F f)
+{
+    std::map<uint64_t, std::string> unacked;
+    {
+        lock_t lock(mutex_);
+        unacked.swap(unacked_);
+    }
+    for (auto& [seq, payload] : unacked) {
+        f(seq, std::string_view(payload));
+    }
+}
+
+inline void Journal::record_(RecordType type, uint64_t seq, std::string_view payload)
+{
+    // called with mutex_ held
+    Segment& segment = segments_.back();
+    if (buffer_.empty() || buffer_.back().segment != segment.id) {
+        buffer_.push_back(Chunk{segment.id, std::string()});
+    }
+
+    std::string& out = buffer_.back().bytes;
+    size_t at = out.size();
+    out.resize(at + HEADER_SIZE);
+    out.append(payload);
+
+    auto length = static_cast<uint32_t>(payload.size());
+    auto t = static_cast<uint8_t>(type);
+    std::memcpy(&out[at], &length, 4);
+    std::memcpy(&out[at + 8], &t, 1);
+    std::memcpy(&out[at + 9], &seq, 8);
+    uint32_t crc = crc32_(&out[at + 8], 9 + payload.size());
+    std::memcpy(&out[at + 4], &crc, 4);
+
+    segment.bytes += HEADER_SIZE + payload.size();
+    buffered_ += HEADER_SIZE + payload.size();
+}
+
+inline uint64_t Journal::append(std::string_view payload)
+{
+    lock_t lock(mutex_);
+    throw_if_failed_();
+
+    if (segments_.back().bytes >= options_.segment_bytes) {
+        segments_.push_back(Segment{segments_.back().id + 1, next_seq_, 0, 0});
+    }
+
+    uint64_t seq = next_seq_++;
+    record_(RECORD_ELEMENT, seq, payload);
+    ++segments_.back().pending;
+
+    if (buffered_ >= options_.batch_bytes) {
+        cv_flush_.notify_one();
+    }
+    return seq;
+}
+
+inline Journal::Segment* Journal::segment_of_(uint64_t seq)
+{
+    auto it = std::upper_bound(
+        segments_.begin(),
+        segments_.end(),
+        seq,
+        [](uint64_t s, const Segment& segment) { return s < segment.first_seq; }
+    );
+    return it == segments_.begin() ? nullptr : &*std::prev(it);
+}
+
+inline void Journal::ack(uint64_t seq)
+{
+    lock_t lock(mutex_);
+    if (Segment* segment = segment_of_(seq); segment && segment->pending > 0) {
+        --segment->pending;
+    }
+    record_(RECORD_ACK, seq, std::string_view());
+}
+
+inline void Journal::wait_durable(uint64_t seq)
+{
+    lock_t lock(mutex_);
+    cv_durable_.wait(lock, [&] { return durable_seq_ >= seq || stopping_ || error_; });
+    if (durable_seq_ < seq) {
+        throw_if_failed_();
+    }
+}
+
+inline void Journal::sync()
+{
+    lock_t lock(mutex_);
+    uint64_t ticket = ++sync_requests_;
+    cv_flush_.notify_one();
+    cv_durable_.wait(lock, [&] { return syncs_done_ >= ticket || stopping_ || error_; });
+    if (syncs_done_ < ticket) {
+        throw_if_failed_();
+    }
+}
+
+inline void Journal::throw_if_failed_() const
+{
+    // called with mutex_ held
+    if (error_) {
+        throw std::system_error(error_, std::generic_category(), "journal " + dir_);
+    }
+}
+
+inline void Journal::flush_()
+{
+    lock_t lock(mutex_);
+    while (true) {
+        cv_flush_.wait_for(lock, options_.batch_interval, [&] {
+            return stopping_
+                || (!error_ && (sync_requests_ > syncs_done_ || buffered_ >= options_.batch_bytes));
+        });
+
+        std::vector<Chunk> chunks;
+        chunks.swap(buffer_);
+        buffered_ = 0;
+        uint64_t requests = sync_requests_;
+        uint64_t seq = next_seq_ - 1;
+        bool stopping = stopping_;
+        bool failed = error_ != 0;
+        lock.unlock();
+
+        // after a failure nothing is written, later records would
+        // follow a gap
+        int error = 0;
+        if (!chunks.empty() && !failed) {
+            error = write_(chunks);
+            syncs_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // fully acked segments are deleted oldest first, the
+        // ones still written to are kept
+        std::vector<uint64_t> deleted;
+        lock.lock();
+        if (error && !error_) {
+            error_ = error;
+        }
+        if (!error_) {
+            durable_seq_ = std::max(durable_seq_, seq);
+            syncs_done_ = requests;
+        }
+        while (segments_.size() > 1
+               && segments_.front().pending == 0
+               && segments_.front().id < open_segment_) {
+            deleted.push_back(segments_.front().id);
+            segments_.pop_front();
+        }
+        cv_durable_.notify_all();
+
+        if (stopping) {
+            break;
+        }
+        if (!deleted.empty()) {
+            lock.unlock();
+            for (uint64_t id : deleted) {
+                ::unlink(path_(id).c_str());
+            }
+            lock.lock();
+        }
+    }
+}
+
+inline int Journal::write_(std::vector<Chunk>& chunks)
+{
+    // returns the errno of the first failure, 0 once all is on disk
+    for (auto& chunk : chunks) {
+        if (chunk.segment != open_segment_) {
+            if (fd_ >= 0) {
+                int synced = fdatasync(fd_);
+                close(fd_);
+                fd_ = -1;
+                if (synced != 0) {
+                    return errno;
+                }
+            }
+            fd_ = ::open(path_(chunk.segment).c_str(), O_CREAT | O_WRONLY | O_APPEND, 0600);
+            if (fd_ < 0) {
+                return errno;
+            }
+            open_segment_ = chunk.segment;
+
+            // make the new file's directory entry durable
+            int dir = ::open(dir_.c_str(), O_RDONLY | O_DIRECTORY);
+            if (dir < 0) {
+                return errno;
+            }
+            int synced = fsync(dir);
+            int error = errno;
+            close(dir);
+            if (synced != 0) {
+                return error;
+            }
+        }
+
+        const char* data = chunk.bytes.data();
+        size_t left = chunk.bytes.size();
+        while (left > 0) {
+            ssize_t n = ::write(fd_, data, left);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno;
+            }
+            data += n;
+            left -= static_cast<size_t>(n);
+        }
+    }
+    if (fd_ >= 0 && fdatasync(fd_) != 0) {
+        return errno;
+    }
+    return 0;
+}
+
+inline const JournalOptions& Journal::options() const
+{ return options_; }
+
+inline std::error_code Journal::error() const
+{
+    lock_t lock(mutex_);
+    return std::error_code(error_, std::generic_category());
+}
+
+inline uint64_t Journal::syncs() const
+{ return syncs_.load(std::memory_order_relaxed); }
+
+inline size_t Journal::segments() const
+{
+    lock_t lock(mutex_);
+    return segments_.size();
+}
+
+}
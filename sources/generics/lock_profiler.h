@@ -0,0 +1,369 @@
+#pragma once
+
+#include <condition_variable>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <map>
+
+namespace gen
+{
+
+/// Log2 histogram of durations in nanoseconds
+class DurationHistogram
+{
+ public:
+    static constexpr size_t N_OF_BUCKETS = 40;
+
+    void add(int64_t ns);
+
+    uint64_t count() const;
+    int64_t  total() const;
+
+    /// Upper bound of the bucket holding the q-quantile, 0 if empty
+    int64_t quantile(double q) const;
+
+    /// Count of bucket i, which holds durations below 2^(i+1) ns
+    uint64_t bucket(size_t i) const;
+
+ private:
+    std::atomic<uint64_t> buckets_[N_OF_BUCKETS] = {};
+    std::atomic<uint64_t> count_{0};
+    std::atomic<int64_t>  total_{0};
+};
+
+/// Counters of all the locks sharing a name
+struct LockStats
+{
+    std::atomic<uint64_t> acquisitions{0};
+    std::atomic<uint64_t> contended{0};
+    DurationHistogram     wait;       // time to acquire a contended lock
+    DurationHistogram     hold;
+    DurationHistogram     cond_wait;  // time blocked in condition variables
+};
+
+struct LockReport
+{
+    std::string name;
+    uint64_t    acquisitions;
+    uint64_t    contended;
+    int64_t     wait_total;
+    int64_t     wait_p50;
+    int64_t     wait_p99;
+    int64_t     hold_total;
+    int64_t     hold_p50;
+    int64_t     hold_p99;
+    uint64_t    cond_waits;
+    int64_t     cond_wait_total;
+};
+
+/// Registry of lock statistics by name, entries live as long as the program
+class LockProfiler
+{
+ public:
+    static LockProfiler& instance();
+
+    LockStats& stats(const std::string& name);
+
+    /// Sorted by total contended wait time, longest first
+    std::vector<LockReport> report() const;
+    void report(std::ostream& out) const;
+
+ private:
+    mutable std::mutex                                mutex_;
+    std::map<std::string, std::unique_ptr<LockStats>> stats_;
+};
+
+/// std::mutex recording acquisitions, contention, wait and hold times
+/// under the name given by name_lock(), "unnamed" by default
+class ProfiledMutex
+{
+ public:
+    ProfiledMutex();
+
+    ProfiledMutex(const ProfiledMutex&) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&) = delete;
+
+    void lock();
+    bool try_lock();
+    void unlock();
+
+    void       set_name(const std::string& name);
+    LockStats& stats();
+
+ private:
+    std::mutex mutex_;
+    LockStats* stats_;
+
+    std::chrono::steady_clock::time_point acquired_;  // guarded by mutex_
+};
+
+/// Condition variable for ProfiledMutex locks, the time spent
+/// waiting is recorded in the stats of the lock's mutex
+class ProfiledCondVar
+{
+ public:
+    using lock_type = std::unique_lock<ProfiledMutex>;
+
+    void notify_one() noexcept;
+    void notify_all() noexcept;
+
+    void wait(lock_type& lock);
+
+    template <class Predicate>
+    void wait(lock_type& lock, Predicate pred);
+
+    template <class Clock, class Duration>
+    std::cv_status wait_until(lock_type& lock, const std::chrono::time_point<Clock, Duration>& deadline);
+
+    template <class Clock, class Duration, class Predicate>
+    bool wait_until(lock_type& lock, const std::chrono::time_point<Clock, Duration>& deadline, Predicate pred);
+
+    template <class Rep, class Period>
+    std::cv_status wait_for(lock_type& lock, const std::chrono::duration<Rep, Period>& timeout);
+
+    template <class Rep, class Period, class Predicate>
+    bool wait_for(lock_type& lock, const std::chrono::duration<Rep, Period>& timeout, Predicate pred);
+
+ private:
+    std::condition_variable_any cv_;
+
+    template <class F>
+    auto timed_(lock_type& lock, F wait);
+};
+
+inline void DurationHistogram::add(int64_t ns)
+{
+    auto n = static_cast<uint64_t>(std::max<int64_t>(ns, 0));
+    size_t bucket = 0;
+    while (n > 1 && bucket + 1 < N_OF_BUCKETS) {
+        n >>= 1;
+        ++bucket;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    total_.fetch_add(ns, std::memory_order_relaxed);
+}
+
+inline uint64_t DurationHistogram::count() const
+{ return count_.load(std::memory_order_relaxed); }
+
+inline int64_t DurationHistogram::total() const
+{ return total_.load(std::memory_order_relaxed); }
+
+inline uint64_t DurationHistogram::bucket(size_t i) const
+{ return buckets_[i].load(std::memory_order_relaxed); }
+
+inline int64_t DurationHistogram::quantile(double q) const
+{
+    uint64_t n = count();
+    if (n == 0) {
+        return 0;
+    }
+
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(n - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < N_OF_BUCKETS; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            return int64_t(1) << (i + 1);
+        }
+    }
+    return int64_t(1) << N_OF_BUCKETS;
+}
+
+inline LockProfiler& LockProfiler::instance()
+{
+    static LockProfiler profiler;
+    return profiler;
+}
+
+inline LockStats& LockProfiler::stats(const std::string& name)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto& stats = stats_[name];
+    if (!stats) {
+        stats = std::make_unique<LockStats>();
+    }
+    return *stats;
+}
+
+inline std::vector<LockReport> LockProfiler::report() const
+{
+    std::vector<LockReport> report;
+
+    std::lock_guard<std::mutex> guard(mutex_);
+    for (auto& [name, s] : stats_) {
+        report.push_back(LockReport{
+            name,
+            s->acquisitions.load(std::memory_order_relaxed),
+            s->contended.load(std::memory_order_relaxed),
+            s->wait.total(),
+            s->wait.quantile(0.5),
+            s->wait.quantile(0.99),
+            s->hold.total(),
+            s->hold.quantile(0.5),
+            s->hold.quantile(0.99),
+            s->cond_wait.count(),
+            s->cond_wait.total()
+        });
+    }
+
+    std::sort(report.begin(), report.end(), [](const LockReport& a, const LockReport& b) {
+        return a.wait_total > b.wait_total;
+    });
+    return report;
+}
+
+inline void LockProfiler::report(std::ostream& out) const
+{
+    auto ms = [](int64_t ns) { return static_cast<double>(ns) / 1e6; };
+
+    out << "[INFO] Lock contention, wait and hold in ns (p50/p99 are bucket bounds)\n"
+        << std::left << std::setw(24) << "lock"
+        << std::right << std::setw(12) << "acquired"
+        << std::setw(12) << "contended"
+        << std::setw(12) << "wait ms"
+        << std::setw(10) << "wait p50"
+        << std::setw(10) << "wait p99"
+        << std::setw(12) << "hold ms"
+        << std::setw(10) << "hold p50"
+        << std::setw(10) << "hold p99"
+        << std::setw(10) << "cv waits"
+        << std::setw(12) << "cv wait ms" << '\n';
+
+    for (const auto& r : report()) {
+        if (r.acquisitions == 0) {
+            continue;
+        }
+        out << std::left << std::setw(24) << r.name
+            << std::right << std::setw(12) << r.acquisitions
+            << std::setw(12) << r.contended
+            << std::setw(12) << std::fixed << std::setprecision(2) << ms(r.wait_total)
+            << std::setw(10) << r.wait_p50
+            << std::setw(10) << r.wait_p99
+            << std::setw(12) << ms(r.hold_total)
+            << std::setw(10) << r.hold_p50
+            << std::setw(10) << r.hold_p99
+            << std::setw(10) << r.cond_waits
+            << std::setw(12) << ms(r.cond_wait_total) << '\n';
+    }
+}
+
+inline ProfiledMutex::ProfiledMutex()
+    : stats_(&LockProfiler::instance().stats("unnamed"))
+{ }
+
+inline void ProfiledMutex::lock()
+{
+    if (!mutex_.try_lock()) {
+        auto begin = std::chrono::steady_clock::now();
+        mutex_.lock();
+        acquired_ = std::chrono::steady_clock::now();
+        stats_->contended.fetch_add(1, std::memory_order_relaxed);
+        stats_->wait.add((acquired_ - begin).count());
+    } else {
+        acquired_ = std::chrono::steady_clock::now();
+    }
+    stats_->acquisitions.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline bool ProfiledMutex::try_lock()
+{
+    if (!mutex_.try_lock()) {
+        return false;
+    }
+    acquired_ = std::chrono::steady_clock::now();
+    stats_->acquisitions.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+inline void ProfiledMutex::unlock()
+{
+    stats_->hold.add((std::chrono::steady_clock::now() - acquired_).count());
+    mutex_.unlock();
+}
+
+inline void ProfiledMutex::set_name(const std::string& name)
+{ stats_ = &LockProfiler::instance().stats(name); }
+
+inline LockStats& ProfiledMutex::stats()
+{ return *stats_; }
+
+inline void ProfiledCondVar::notify_one() noexcept
+{ cv_.notify_one(); }
+
+inline void ProfiledCondVar::notify_all() noexcept
+{ cv_.notify_all(); }
+
+template <class F>
+auto ProfiledCondVar::timed_(lock_type& lock, F wait)
+{
+    // the mutex is reacquired before wait returns, so its
+    // stats are updated while it is held
+    auto begin = std::chrono::steady_clock::now();
+    auto result = wait();
+    lock.mutex()->stats().cond_wait.add((std::chrono::steady_clock::now() - begin).count());
+    return result;
+}
+
+inline void ProfiledCondVar::wait(lock_type& lock)
+{
+    timed_(lock, [&] {
+        cv_.wait(lock);
+        return true;
+    });
+}
+
+template <class Predicate>
+void ProfiledCondVar::wait(lock_type& lock, Predicate pred)
+{
+    while (!pred()) {
+        wait(lock);
+    }
+}
+
+template <class Clock, class Duration>
+std::cv_status ProfiledCondVar::wait_until(
+    lock_type& lock,
+    const std::chrono::time_point<Clock, Duration>& deadline
+)
+{ return timed_(lock, [&] { return cv_.wait_until(lock, deadline); }); }
+
+template <class Clock, class Duration, class Predicate>
+bool ProfiledCondVar::wait_until(
+    lock_type& lock,
+    const std::chrono::time_point<Clock, Duration>& deadline,
+    Predicate pred
+)
+{
+    while (!pred()) {
+        if (wait_until(lock, deadline) == std::cv_status::timeout) {
+            return pred();
+        }
+    }
+    return true;
+}
+
+template <class Rep, class Period>
+std::cv_status ProfiledCondVar::wait_for(
+    lock_type& lock,
+    const std::chrono::duration<Rep, Period>& timeout
+)
+{ return wait_until(lock, std::chrono::steady_clock::now() + timeout); }
+
+template <class Rep, class Period, class Predicate>
+bool ProfiledCondVar::wait_for(
+    lock_type& lock,
+    const std::chrono::duration<Rep, Period>& timeout,
+    Predicate pred
+)
+{ return wait_until(lock, std::chrono::steady_clock::now() + timeout, std::move(pred)); }
+
+}
@@ -1,181 +1,2058 @@
-#pragma once
-
-#include "queue.h"
-#include "gendef.h"
-#include "resource.h"
-#include "handler.h"
-
-namespace gen
-{
-
-template <class T>
-class ResourceManager
-{
- public:
-    using resource_t = Resource<T>;
-    using handler_t = DataHandler<T>;
-    using data_t = T;
-
-    ResourceManager
-        (
-            resource_t& resource,
-            handler_t& handler,
-            size_t max_queue_size,
-            size_t n_of_threads
-        );
-
-    ~ResourceManager();
-
-    ResourceManager() = delete;
-    ResourceManager(const ResourceManager&) = delete;
-
-    void start();
-    void stop();
-
-    void save_session_data(Queue<T>& backup);
-    void restore_session_data(Queue<T>& backup);
-
- private:
-    resource_t& resource_;
-    handler_t & handler_;
-
-    std::vector<thread_t> threads_;
-    size_t                n_of_threads_;
-
-    Queue<data_t> queue_;
-
-    mutex_t resource_mutex_;
-    mutex_t queue_mutex_;
-
-    cond_var_t cv_run_;
-    cond_var_t cv_put_;
-
-    Status current_state_;
-
-    void receive_data_();
-    void process_data_();
-};
-
-template <class T>
-ResourceManager<T>::ResourceManager(
-    resource_t& resource,
-    handler_t& handler,
-    size_t max_queue_size,
-    size_t n_of_threads
-)
-    : resource_(resource),
-      handler_(handler),
-      n_of_threads_(n_of_threads),
-      queue_(max_queue_size),
-      current_state_(STATUS_STOPPED)
-{ threads_.reserve(n_of_threads); }
-
-template <class T>
-ResourceManager<T>::~ResourceManager()
-{
-    stop();
-#ifdef __INFO_DEBUG__
-    if (!queue_.empty()) {
-        std::string leak_info =
-            std::string("Unsaved data leak detected: ") +
-            std::to_string(queue_.size()) +
-            std::string(" elements are pending.\n");
-        UnsavedDataLeak(leak_info.c_str()).what();
-    }
-#endif  // __INFO_DEBUG__
-}
-
-template <class T>
-void ResourceManager<T>::start()
-{
-    current_state_ = STATUS_RUNNING;
-
-    threads_.template emplace_back([&] { receive_data_(); });
-
-    for (size_t i = 1; i < n_of_threads_; ++i) {
-        threads_.template emplace_back([&] { process_data_(); });
-    }
-
-    cv_put_.notify_one();
-    cv_run_.notify_all();
-}
-
-template <class T>
-void ResourceManager<T>::stop()
-{
-    current_state_ = STATUS_STOPPED;
-    cv_put_.notify_one();
-    cv_run_.notify_all();
-
-    for (auto& t : threads_) {
-        t.join();
-    }
-
-    threads_.clear();
-}
-
-template <class T>
-void ResourceManager<T>::receive_data_()
-{
-    while (current_state_ != STATUS_STOPPED) {
-        lock_t lock(resource_mutex_);
-
-        while (resource_.is_empty() && current_state_ != STATUS_STOPPED) { }
-
-        cv_put_.wait(
-            lock,
-            [&] { return !queue_.full() || current_state_ == STATUS_STOPPED; }
-        );
-
-        if (current_state_ == STATUS_RUNNING && !resource_.is_empty()) {
-            queue_.template emplace(std::move(resource_.get_data()));
-            cv_run_.notify_one();
-        }
-    }
-}
-
-template <class T>
-void ResourceManager<T>::process_data_()
-{
-    while (current_state_ != STATUS_STOPPED) {
-        lock_t lock(queue_mutex_);
-        cv_run_.wait(
-            lock,
-            [&] { return !queue_.empty() || current_state_ == STATUS_STOPPED; }
-        );
-        lock.unlock();
-
-        if (!queue_.empty() && current_state_ == STATUS_RUNNING) {
-            handler_.process(std::move(queue_.take_first()));
-            cv_put_.notify_one();
-        }
-    }
-}
-
-template <class T>
-void ResourceManager<T>::save_session_data(gen::Queue<T>& backup)
-{
-    if (current_state_ == STATUS_RUNNING) {
-        stop();
-    }
-    queue_.move_to(backup);
-}
-
-template <class T>
-void ResourceManager<T>::restore_session_data(gen::Queue<T>& backup)
-{
-    if (current_state_ == STATUS_RUNNING) {
-        stop();
-    }
-#ifdef __INFO_DEBUG__
-    if (queue_.max_size() < queue_.size() + backup.size()) {
-        WaitingQueueOverflow(
-            "Not all saved data will be processed: "
-            "there are not enough free space for restoring\n"
-        ).what();
-    }
-#endif // __INFO_DEBUG__
-    backup.move_to(queue_);
-}
-
-}
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "queue.h"
+#include "stats.h"
+#include "lock_profiler.h"
+#include "gendef.h"
+#include "coalescer.h"
+#include "scheduler.h"
+#include "rate_limiter.h"
+#include "executor.h"
+#include "autoscale.h"
+#include "batching.h"
+#include "wait.h"
+#include "monitor.h"
+#include "footprint.h"
+#include "tracing.h"
+#include "watchdog.h"
+#include "journal.h"
+#include "producer.h"
+#include "slab.h"
+#include "completion.h"
+#include "resource.h"
+#include "handler.h"
+
+namespace gen
+{
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+class BasicResourceManager
+{
+ public:
+    using resource_t = Res;
+    using handler_t = H;
+    using data_t = resource_data_t<Res>;
+    using result_t = handler_result_t<H, data_t>;
+    using completion_t = Completion<result_t>;
+
+    BasicResourceManager
+        (
+            resource_t& resource,
+            handler_t& handler,
+            size_t max_queue_size,
+            size_t n_of_threads
+        );
+
+    ~BasicResourceManager();
+
+    BasicResourceManager() = delete;
+    BasicResourceManager(const BasicResourceManager&) = delete;
+
+    void start();
+
+    /// Finishes handlers in flight and terminates all threads
+    void stop();
+
+    /// Bounded stop: draining modes keep processing waiting elements
+    /// (STOP_DRAIN_DEADLINE at most for timeout), then handlers in
+    /// flight are cancelled through their stop tokens and given grace
+    /// time to return; elements they give up are kept for saving.
+    /// Threads which do not return in time are left running and
+    /// joined in the destructor, runs of a shared executor are
+    /// waited for
+    void stop(
+        StopMode mode,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+        std::chrono::milliseconds grace = std::chrono::milliseconds(50)
+    );
+
+    /// Queues data bypassing the resource and waits while the queue
+    /// is full; the handle gets the handler's result or is dropped
+    /// if the element is moved to a backup unprocessed
+    completion_t submit(data_t data);
+
+    /// Queues the elements like submit() without handles, taking
+    /// the queue lock once unless the queue fills up; empties batch
+    void submit_all(std::vector<data_t>& batch);
+
+    /// Returns a producer whose per-thread buffers are flushed with
+    /// submit_all(); stop() and save_session_data() flush all of them
+    /// first. A producer may outlive the manager, elements it flushes
+    /// afterwards are discarded
+    std::shared_ptr<BufferedProducer<data_t>> make_producer(ProducerPolicy policy = ProducerPolicy());
+
+    /// Elements which threads left running by a bounded stop() give
+    /// up later are saved to backup too, so it must outlive them,
+    /// until start() or the manager's destruction
+    void save_session_data(Queue<data_t>& backup);
+    void restore_session_data(Queue<data_t>& backup);
+
+    /// Reads atomic counters only, so it can be polled often
+    ManagerStats stats() const;
+
+    /// Keeps the distribution of the time from receipt to completion
+    /// of processed elements, read by latency(); must be called
+    /// while stopped
+    void enable_latency_histogram();
+
+    /// nullptr unless the histogram is enabled
+    const DurationHistogram* latency() const;
+
+    /// Merges waiting elements with equal key_of(x): only the first one
+    /// is processed, the rest are passed to on_merged(x) afterwards and
+    /// their handles get a copy of the first one's result;
+    /// must be called while the manager is stopped
+    template <class KeyOf, class OnMerged>
+    void enable_coalescing(KeyOf key_of, OnMerged on_merged);
+
+    /// Distributes elements into n_of_lanes lanes by key_of(x); elements
+    /// of one lane are processed in order, one at a time, while different
+    /// lanes are processed in parallel; must be called while stopped
+    template <class KeyOf>
+    void enable_partitioning(KeyOf key_of, size_t n_of_lanes);
+
+    /// Hands waiting elements to workers by earliest deadline_of(x),
+    /// a steady_clock time point, and drops the ones whose deadline
+    /// has passed before they are processed, counted as expired.
+    /// Replaces partitioning; must be called while stopped
+    template <class DeadlineOf>
+    void enable_deadlines(DeadlineOf deadline_of);
+
+    /// Takes a token from limiter for every element at point; elements
+    /// over the limit are dropped, delayed until a token is available
+    /// or passed to on_overflow(x) according to action;
+    /// must be called while stopped
+    void limit_rate(
+        std::shared_ptr<RateLimiter<data_t>> limiter,
+        LimitPoint point,
+        OverLimit action,
+        std::function<void(data_t&&)> on_overflow = nullptr
+    );
+
+    /// Runs the workers on executor instead of own threads, at most
+    /// n_of_threads - 1 elements are processed at once; the receiver
+    /// keeps its own thread. Must be called while stopped
+    void use_executor(std::shared_ptr<Executor> executor);
+
+    /// Grows and shrinks the own workers between the policy bounds
+    /// according to queue depth, queue wait time and utilization,
+    /// checked by a supervisor thread every policy.interval;
+    /// ignored with an executor. Must be called while stopped
+    void enable_autoscaling(AutoscalePolicy policy);
+
+    /// Lets own workers take up to a batch of waiting elements at once
+    /// and linger for more to fill it; a BatchController adjusts both
+    /// every policy.interval from the arrival rate, queue depth,
+    /// service time and p99 latency. Handlers with
+    /// process_batch(std::vector<data_t>&&) get a batch per call,
+    /// others are called per element. Not used with partitioning or
+    /// an executor, nor process_batch with a watchdog.
+    /// Must be called while stopped
+    void enable_batching(BatchPolicy policy);
+
+    /// How idle own workers wait for elements: WAIT_SPIN_PARK spins
+    /// and yields as policy says before parking, which saves the wake
+    /// syscall and context switch while elements arrive often, at the
+    /// cost of CPU time; must be called while stopped
+    void set_wait_strategy(WaitStrategy strategy, SpinPolicy policy = SpinPolicy());
+
+    /// Keeps a summary of waiting elements by class_of(x) < n_of_classes
+    /// and by integer key_of(x), read by pending_snapshot() without
+    /// blocking producers or workers; must be called once while stopped
+    template <class ClassOf, class KeyOf>
+    void enable_monitoring(ClassOf class_of, KeyOf key_of, MonitorOptions options);
+
+    /// Count per class, oldest element age and top_n keys by count
+    /// of the waiting elements; empty if monitoring is not enabled
+    PendingSnapshot pending_snapshot(size_t top_n = 10) const;
+
+    /// Bounds the bytes held by waiting elements as well as their
+    /// count, an element's size is footprint(x), Footprint<data_t>
+    /// by default; producers wait until the element fits, unless
+    /// the queue is empty. Must be called while stopped
+    void set_byte_budget(size_t max_bytes);
+
+    template <class F>
+    void set_byte_budget(size_t max_bytes, F footprint);
+
+    /// Watches handler calls: calls running longer than
+    /// policy.stuck_after are passed to on_stuck and counted, and
+    /// may get a replacement worker or a hedged second dispatch as
+    /// the policy says. Must be called while stopped
+    void enable_watchdog(
+        WatchdogPolicy policy,
+        std::function<void(const StuckCall&)> on_stuck = nullptr
+    );
+
+    /// Records the receive, queued, idle and process spans of the
+    /// elements the tracer samples; nullptr turns tracing off.
+    /// Must be called while stopped
+    void enable_tracing(std::shared_ptr<Tracer> tracer);
+
+    /// Appends accepted elements to a write-ahead journal in dir,
+    /// encoded by Codec, and acks them once processed, dropped or
+    /// saved; elements the journal holds without an ack from an
+    /// earlier run are queued again now. Records are synced to disk
+    /// in groups as options say. Must be called once while stopped.
+    /// Once a write or sync has failed, submit() and
+    /// restore_session_data() throw std::system_error, while the
+    /// receiver and producers go on without durability
+    template <class Codec = JournalCodec<data_t>>
+    void enable_journal(const std::string& dir, JournalOptions options = JournalOptions());
+
+    /// The journal's first failed write or sync, empty without one
+    std::error_code journal_error() const;
+
+ private:
+    using pool_t = CompletionPool<result_t>;
+    using slot_t = typename pool_t::index_t;
+    using value_t = typename pool_t::value_t;
+    using time_point_t = std::chrono::steady_clock::time_point;
+
+    struct Item
+    {
+        data_t       data;
+        slot_t       slot;
+        time_point_t received;
+        size_t       bytes;
+        uint64_t     trace_id;  // 0 if not sampled
+        time_point_t deadline;
+        uint64_t     seq;  // in the journal, 0 if not journaled
+
+        // set while a hedged copy may exist, true once one of
+        // the two has finished the element
+        std::shared_ptr<std::atomic_bool> race;
+        bool                              hedge;  // the copy
+    };
+
+    // a handler call in flight, scanned by the watchdog
+    struct Call
+    {
+        mutex_t             mutex;
+        int64_t             started = 0;  // steady_clock ns, 0 if idle
+        std::thread::id     thread;
+        bool                flagged = false;
+        bool                replaced = false;
+        std::optional<Item> hedge;
+    };
+
+    struct Runner final : Executable
+    {
+        BasicResourceManager& manager;
+
+        explicit Runner(BasicResourceManager& m)
+            : manager(m)
+        { }
+
+        bool run_one() override
+        { return manager.run_one_(); }
+    };
+
+    resource_t& resource_;
+    handler_t & handler_;
+
+    std::vector<thread_t> threads_;
+    std::vector<thread_t> stragglers_;
+    size_t                n_of_threads_;
+
+    std::unique_ptr<Scheduler<Item>> scheduler_;
+    Queue<Item>                      requeued_;
+    Queue<data_t>*                   late_backup_;  // saved to while stragglers run
+    size_t                           max_queue_size_;
+
+    // footprint of the elements in the queue and in requeued_,
+    // and of the ones saved to backups and not restored yet
+    std::function<size_t(const data_t&)> footprint_;
+
+    std::function<time_point_t(const data_t&)> deadline_of_;
+    size_t                               max_bytes_;
+    std::atomic<size_t>                  bytes_;
+    std::atomic<size_t>                  backup_bytes_;
+    std::atomic<size_t>                  held_;    // elements counted in bytes_
+    std::atomic<size_t>                  backup_;  // elements in backup_bytes_
+
+    mutex_t         resource_mutex_;
+    mutable mutex_t queue_mutex_;
+
+    cond_var_t cv_run_;
+    cond_var_t cv_put_;
+    cond_var_t cv_done_;
+    cond_var_t cv_state_;
+
+    std::atomic<Status> current_state_;
+
+    // threads of the current start() which have not returned yet
+    size_t   active_threads_;
+    uint64_t generation_;
+
+    std::atomic<uint64_t> received_;
+    std::atomic<uint64_t> processed_;
+    std::atomic<uint64_t> coalesced_;
+    std::atomic<uint64_t> requeued_count_;
+    std::atomic<uint64_t> rejected_;
+    std::atomic<uint64_t> delayed_;
+    std::atomic<uint64_t> overflowed_;
+    std::atomic<uint64_t> expired_;
+
+    std::unique_ptr<Coalescer<Item>>      coalescer_;
+    std::unique_ptr<PendingMonitor<Item>> monitor_;
+    pool_t                                completions_;
+
+    std::shared_ptr<RateLimiter<data_t>> limiter_;
+    LimitPoint                           limit_point_;
+    OverLimit                            over_limit_;
+    std::function<void(data_t&&)>        on_overflow_;
+
+    // executor mode: workers are runs of runner_ on the executor,
+    // counted as one thread until the manager is drained or stopped
+    std::shared_ptr<Executor> executor_;
+    Runner                    runner_;
+    std::stop_source          stop_source_;
+    size_t                    in_flight_;
+    bool                      attached_;
+    bool                      executor_share_;
+
+    // autoscaling: workers above target_workers_ retire and their
+    // threads are joined by the supervisor
+    std::unique_ptr<Autoscaler>  autoscaler_;
+    std::atomic<size_t>          workers_;
+    size_t                       target_workers_;
+    std::vector<std::thread::id> retired_;
+    std::atomic<int64_t>         busy_ns_;
+    std::atomic<int64_t>         wait_ns_;
+    std::atomic<uint64_t>        waited_;
+    std::atomic<uint64_t>        scale_ups_;
+    std::atomic<uint64_t>        scale_downs_;
+
+    // batching: workers take up to batch_limit_ elements, samples
+    // for the controller are gathered under batch_mutex_
+    std::unique_ptr<BatchController> batcher_;
+    std::atomic<size_t>              batch_limit_;
+    std::atomic<int64_t>             linger_ns_;
+    std::atomic<uint64_t>            batches_;
+    mutex_t                          batch_mutex_;
+    std::vector<int64_t>             latencies_;
+    int64_t                          service_ns_;
+    uint64_t                         sampled_;
+    uint64_t                         arrivals_;
+    time_point_t                     decided_;
+
+    WaitStrategy wait_strategy_;
+    SpinPolicy   spin_policy_;
+    EventCount   events_;
+
+    std::shared_ptr<Tracer> tracer_;
+
+    std::unique_ptr<Watchdog> watchdog_;
+    Slab<Call>                calls_;
+    std::atomic<uint64_t>     stuck_;
+    std::atomic<uint64_t>     replaced_;
+    std::atomic<uint64_t>     hedged_;
+
+    std::unique_ptr<DurationHistogram> latency_;
+
+    std::unique_ptr<Journal>                        journal_;
+    std::function<void(const data_t&, std::string&)> encode_;
+    std::atomic<uint64_t>                           replayed_;
+
+    // sinks of producers reach the manager through the link,
+    // which the destructor clears
+    struct ProducerLink
+    {
+        mutex_t               mutex;
+        BasicResourceManager* manager;
+    };
+
+    mutex_t                                                producers_mutex_;
+    std::vector<std::shared_ptr<BufferedProducer<data_t>>> producers_;
+    std::shared_ptr<ProducerLink>                          producer_link_;
+
+    void receive_data_();
+    void process_data_(std::stop_token token);
+    void flush_producers_();
+    bool run_one_();
+    void exit_executor_();
+    void detach_();
+    void wake_one_();
+    void wake_all_();
+    bool drained_() const;
+    void replace_scheduler_(std::unique_ptr<Scheduler<Item>> scheduler);
+    void supervise_();
+    void watch_();
+    void join_retired_(lock_t& lock);
+    uint32_t begin_call_(Item& item);
+    bool end_call_(uint32_t index);
+    void spawn_worker_();
+    void thread_exit_(uint64_t generation);
+
+    template <class F>
+    void spawn_(F f);
+    void set_state_(Status state);
+    bool wait_threads_(std::chrono::steady_clock::time_point deadline);
+    void requeue_(Item&& item, std::vector<Item>& followers);
+    void save_(Item&& item, Queue<data_t>& backup);
+
+    Item make_item_(data_t&& data);
+    void hold_(const Item& item);
+    void release_(const Item& item);
+    bool has_space_(size_t bytes = 0) const;
+    void push_(Item&& item);
+    void process_item_(Item&& item, std::stop_token token);
+    bool run_item_(Item&& item, std::stop_token token, int64_t idle_since);
+    void take_batch_(lock_t& lock, std::vector<Item>& batch);
+    bool run_batch_(std::vector<Item>& batch, std::stop_token token, int64_t idle_since, size_t depth);
+    void call_batch_(std::vector<Item>& batch, std::stop_token token);
+    void sample_batch_(int64_t service_ns, const std::vector<int64_t>& latencies, size_t depth);
+    void finish_lane_(size_t lane);
+    void complete_(Item& item, std::vector<Item>& followers, value_t&& result);
+    void drop_(Item& item);
+    void journal_item_(Item& item);
+    void journal_unchecked_(Item& item);
+    void ack_(const Item& item);
+    bool admit_(Item& item, std::vector<Item>& followers);
+};
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+BasicResourceManager<Res, H>::BasicResourceManager(
+    resource_t& resource,
+    handler_t& handler,
+    size_t max_queue_size,
+    size_t n_of_threads
+)
+    : resource_(resource),
+      handler_(handler),
+      n_of_threads_(n_of_threads),
+      scheduler_(std::make_unique<FifoScheduler<Item>>(max_queue_size)),
+      late_backup_(nullptr),
+      max_queue_size_(max_queue_size),
+      footprint_(Footprint<data_t>()),
+      max_bytes_(0),
+      bytes_(0),
+      backup_bytes_(0),
+      held_(0),
+      backup_(0),
+      current_state_(STATUS_STOPPED),
+      active_threads_(0),
+      generation_(0),
+      received_(0),
+      processed_(0),
+      coalesced_(0),
+      requeued_count_(0),
+      rejected_(0),
+      delayed_(0),
+      overflowed_(0),
+      expired_(0),
+      limit_point_(LIMIT_AT_INGESTION),
+      over_limit_(OVER_LIMIT_DELAY),
+      runner_(*this),
+      in_flight_(0),
+      attached_(false),
+      executor_share_(false),
+      workers_(0),
+      target_workers_(0),
+      busy_ns_(0),
+      wait_ns_(0),
+      waited_(0),
+      scale_ups_(0),
+      scale_downs_(0),
+      batch_limit_(1),
+      linger_ns_(0),
+      batches_(0),
+      service_ns_(0),
+      sampled_(0),
+      arrivals_(0),
+      wait_strategy_(WAIT_BLOCK),
+      calls_(4096),
+      stuck_(0),
+      replaced_(0),
+      hedged_(0),
+      replayed_(0),
+      producer_link_(std::make_shared<ProducerLink>())
+{
+    producer_link_->manager = this;
+    threads_.reserve(n_of_threads);
+    name_lock(resource_mutex_, "manager.resource");
+    name_lock(queue_mutex_, "manager.queue");
+    name_lock(batch_mutex_, "manager.batch");
+    name_lock(producers_mutex_, "manager.producers");
+    name_lock(producer_link_->mutex, "manager.producer_link");
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+BasicResourceManager<Res, H>::~BasicResourceManager()
+{
+    stop();
+    {
+        lock_t lock(producer_link_->mutex);
+        producer_link_->manager = nullptr;
+    }
+    producers_.clear();
+    stragglers_.clear();
+#ifdef __INFO_DEBUG__
+    if (!scheduler_->empty() || !requeued_.empty()) {
+        std::string leak_info =
+            std::string("Unsaved data leak detected: ") +
+            std::to_string(scheduler_->size() + requeued_.size()) +
+            std::string(" elements are pending.\n");
+        UnsavedDataLeak(leak_info.c_str()).what();
+    }
+#endif  // __INFO_DEBUG__
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::start()
+{
+    {
+        lock_t lock(queue_mutex_);
+        if (!requeued_.empty()) {
+            while (auto item = scheduler_->take_any()) {
+                requeued_.emplace(std::move(*item));
+            }
+            while (!requeued_.empty()) {
+                scheduler_->push(requeued_.take_first());
+            }
+        }
+        size_t workers = n_of_threads_ ? n_of_threads_ - 1 : 0;
+        if (autoscaler_) {
+            workers = std::clamp(
+                workers,
+                autoscaler_->policy().min_workers,
+                autoscaler_->policy().max_workers
+            );
+        }
+
+        current_state_ = STATUS_RUNNING;
+        late_backup_ = nullptr;
+        workers_ = target_workers_ = executor_ ? 0 : workers;
+        active_threads_ = executor_ ? 2 : 1 + workers_ + (autoscaler_ ? 1 : 0);
+        active_threads_ += watchdog_ ? 1 : 0;
+        executor_share_ = executor_ != nullptr;
+        retired_.clear();
+        ++generation_;
+    }
+
+    spawn_([this](std::stop_token) { receive_data_(); });
+
+    if (executor_) {
+        stop_source_ = std::stop_source();
+        if (!attached_) {
+            executor_->attach(runner_, n_of_threads_ > 1 ? n_of_threads_ - 1 : 1);
+            attached_ = true;
+        }
+        executor_->notify(runner_);
+        if (watchdog_) {
+            spawn_([this](std::stop_token) { watch_(); });
+        }
+    } else {
+        for (size_t i = 0; i < workers_; ++i) {
+            spawn_worker_();
+        }
+        if (autoscaler_) {
+            // the supervisor spawns threads too, so it starts
+            // only when threads_ is not being modified here
+            lock_t lock(queue_mutex_);
+            spawn_([this](std::stop_token) { supervise_(); });
+        }
+        if (watchdog_) {
+            lock_t lock(queue_mutex_);
+            spawn_([this](std::stop_token) { watch_(); });
+        }
+    }
+
+    cv_put_.notify_all();
+    wake_all_();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::stop()
+{
+    flush_producers_();
+    set_state_(STATUS_STOPPED);
+
+    for (auto& t : threads_) {
+        t.join();
+    }
+
+    threads_.clear();
+    detach_();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::stop(
+    StopMode mode,
+    std::chrono::milliseconds timeout,
+    std::chrono::milliseconds grace
+)
+{
+    using clock = std::chrono::steady_clock;
+
+    flush_producers_();
+    if (mode == STOP_DRAIN) {
+        set_state_(STATUS_DRAINING);
+        for (auto& t : threads_) {
+            t.join();
+        }
+        threads_.clear();
+        if (executor_) {
+            lock_t lock(queue_mutex_);
+            cv_done_.wait(lock, [&] { return active_threads_ == 0; });
+        }
+        set_state_(STATUS_STOPPED);
+        detach_();
+        return;
+    }
+
+    if (mode == STOP_DRAIN_DEADLINE) {
+        set_state_(STATUS_DRAINING);
+        wait_threads_(clock::now() + timeout);
+    }
+
+    set_state_(STATUS_STOPPED);
+    for (auto& t : threads_) {
+        t.request_stop();
+    }
+    stop_source_.request_stop();
+
+    // executor runs still in flight are waited for in detach_()
+    if (wait_threads_(clock::now() + grace)) {
+        threads_.clear();
+        detach_();
+    } else {
+        // what the stragglers give up later goes to requeued_, or to
+        // the backup of a save_session_data() made in the meantime
+        for (auto& t : threads_) {
+            stragglers_.push_back(std::move(t));
+        }
+        threads_.clear();
+        detach_();
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+template <class F>
+void BasicResourceManager<Res, H>::spawn_(F f)
+{
+    threads_.template emplace_back(
+        [this, f, generation = generation_](std::stop_token token) mutable {
+            f(token);
+            thread_exit_(generation);
+        }
+    );
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::thread_exit_(uint64_t generation)
+{
+    lock_t lock(queue_mutex_);
+    if (generation == generation_ && --active_threads_ == 0) {
+        cv_done_.notify_all();
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::set_state_(Status state)
+{
+    {
+        lock_t lock(queue_mutex_);
+        current_state_ = state;
+        exit_executor_();
+    }
+    cv_put_.notify_all();
+    wake_all_();
+    cv_state_.notify_all();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::wait_threads_(
+    std::chrono::steady_clock::time_point deadline
+)
+{
+    lock_t lock(queue_mutex_);
+    return cv_done_.wait_until(lock, deadline, [&] { return active_threads_ == 0; });
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+typename BasicResourceManager<Res, H>::completion_t
+BasicResourceManager<Res, H>::submit(data_t data)
+{
+    Item item = make_item_(std::move(data));
+    completion_t handle = completions_.open(item.slot);
+    received_.fetch_add(1, std::memory_order_relaxed);
+
+    std::vector<Item> none;
+    if (limit_point_ == LIMIT_AT_INGESTION && !admit_(item, none)) {
+        return handle;
+    }
+    if (journal_) {
+        try {
+            journal_item_(item);
+        } catch (const std::system_error&) {
+            drop_(item);
+            throw;
+        }
+    }
+
+    if (coalescer_ && coalescer_->try_merge(item)) {
+        coalesced_.fetch_add(1, std::memory_order_relaxed);
+        return handle;
+    }
+
+    lock_t lock(queue_mutex_);
+    cv_put_.wait(
+        lock,
+        [&] { return has_space_(item.bytes) || current_state_ != STATUS_RUNNING; }
+    );
+    uint64_t trace_id = item.trace_id;
+    hold_(item);
+    scheduler_->push(std::move(item));
+    lock.unlock();
+
+    if (trace_id) {
+        tracer_->async_begin("queued", trace_id, "producer");
+    }
+    wake_one_();
+    return handle;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::submit_all(std::vector<data_t>& batch)
+{
+    std::vector<Item> items;
+    items.reserve(batch.size());
+    for (auto& data : batch) {
+        Item item = make_item_(std::move(data));
+        received_.fetch_add(1, std::memory_order_relaxed);
+
+        std::vector<Item> none;
+        if (limit_point_ == LIMIT_AT_INGESTION && !admit_(item, none)) {
+            continue;
+        }
+        if (journal_) {
+            journal_unchecked_(item);
+        }
+        if (coalescer_ && coalescer_->try_merge(item)) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        items.push_back(std::move(item));
+    }
+    batch.clear();
+
+    std::vector<uint64_t> traced;
+    size_t queued = 0;
+    auto wake = [&] {
+        for (; queued; --queued) {
+            wake_one_();
+        }
+    };
+
+    lock_t lock(queue_mutex_);
+    for (auto& item : items) {
+        if (queued && !has_space_(item.bytes)) {
+            // workers have to make room for the rest
+            lock.unlock();
+            wake();
+            lock.lock();
+        }
+        cv_put_.wait(
+            lock,
+            [&] { return has_space_(item.bytes) || current_state_ != STATUS_RUNNING; }
+        );
+        if (item.trace_id) {
+            traced.push_back(item.trace_id);
+        }
+        hold_(item);
+        scheduler_->push(std::move(item));
+        ++queued;
+    }
+    lock.unlock();
+
+    for (uint64_t trace_id : traced) {
+        tracer_->async_begin("queued", trace_id, "producer");
+    }
+    wake();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+std::shared_ptr<BufferedProducer<typename BasicResourceManager<Res, H>::data_t>>
+BasicResourceManager<Res, H>::make_producer(ProducerPolicy policy)
+{
+    auto producer = std::make_shared<BufferedProducer<data_t>>(
+        [link = producer_link_](std::vector<data_t>& batch) {
+            lock_t lock(link->mutex);
+            if (link->manager) {
+                link->manager->submit_all(batch);
+            }
+        },
+        policy
+    );
+    lock_t lock(producers_mutex_);
+    producers_.push_back(producer);
+    return producer;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::flush_producers_()
+{
+    lock_t lock(producers_mutex_);
+    for (auto& producer : producers_) {
+        producer->flush();
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::receive_data_()
+{
+    while (current_state_ == STATUS_RUNNING) {
+        lock_t resource_lock(resource_mutex_);
+
+        while (resource_.is_empty() && current_state_ == STATUS_RUNNING) { }
+
+        lock_t lock(queue_mutex_);
+        cv_put_.wait(
+            lock,
+            [&] { return has_space_() || current_state_ != STATUS_RUNNING; }
+        );
+        lock.unlock();
+
+        if (current_state_ == STATUS_RUNNING && !resource_.is_empty()) {
+            int64_t begin = tracer_ ? tracer_->now() : 0;
+            Item item = make_item_(resource_.get_data());
+            received_.fetch_add(1, std::memory_order_relaxed);
+            if (item.trace_id) {
+                tracer_->complete("receive", item.trace_id, begin, tracer_->now(), "receiver");
+            }
+
+            std::vector<Item> none;
+            if (limit_point_ == LIMIT_AT_INGESTION && !admit_(item, none)) {
+                continue;
+            }
+            if (journal_) {
+                journal_unchecked_(item);
+            }
+
+            if (coalescer_ && coalescer_->try_merge(item)) {
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+
+            push_(std::move(item));
+        }
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::spawn_worker_()
+{ spawn_([this](std::stop_token token) { process_data_(token); }); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::supervise_()
+{
+    using clock = std::chrono::steady_clock;
+
+    const auto& policy = autoscaler_->policy();
+    auto last = clock::now();
+    int64_t last_busy = busy_ns_.load(std::memory_order_relaxed);
+
+    lock_t lock(queue_mutex_);
+    while (true) {
+        cv_state_.wait_for(lock, policy.interval, [&] {
+            return current_state_ != STATUS_RUNNING;
+        });
+        if (current_state_ != STATUS_RUNNING) {
+            break;
+        }
+
+        auto now = clock::now();
+        int64_t busy = busy_ns_.load(std::memory_order_relaxed);
+        uint64_t waited = waited_.exchange(0, std::memory_order_relaxed);
+        int64_t wait_ns = wait_ns_.exchange(0, std::memory_order_relaxed);
+        size_t workers = workers_;
+        double elapsed = static_cast<double>((now - last).count()) * (workers ? workers : 1);
+
+        AutoscaleSample sample{
+            workers,
+            scheduler_->size(),
+            static_cast<double>(busy - last_busy) / elapsed,
+            waited ? static_cast<double>(wait_ns) / static_cast<double>(waited) / 1e6 : 0
+        };
+        last = now;
+        last_busy = busy;
+
+        size_t target = autoscaler_->decide(sample);
+        if (target > target_workers_) {
+            scale_ups_.fetch_add(1, std::memory_order_relaxed);
+        } else if (target < target_workers_) {
+            scale_downs_.fetch_add(1, std::memory_order_relaxed);
+        }
+        target_workers_ = target;
+
+        for (; workers_ < target_workers_; ++workers_) {
+            ++active_threads_;
+            spawn_worker_();
+        }
+        if (workers_ > target_workers_) {
+            wake_all_();
+        }
+
+        join_retired_(lock);
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::join_retired_(lock_t& lock)
+{
+    // join retired workers outside of the lock,
+    // they need it to exit
+    std::vector<thread_t> finished;
+    for (auto id : retired_) {
+        auto it = std::find_if(threads_.begin(), threads_.end(), [&](const thread_t& t) {
+            return t.get_id() == id;
+        });
+        finished.push_back(std::move(*it));
+        threads_.erase(it);
+    }
+    retired_.clear();
+
+    lock.unlock();
+    finished.clear();
+    lock.lock();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::watch_()
+{
+    const auto& policy = watchdog_->policy();
+
+    lock_t lock(queue_mutex_);
+    while (true) {
+        cv_state_.wait_for(lock, policy.interval, [&] {
+            return current_state_ != STATUS_RUNNING;
+        });
+        if (current_state_ != STATUS_RUNNING) {
+            break;
+        }
+        lock.unlock();
+        watchdog_->update();
+
+        std::vector<StuckCall> stuck;
+        std::vector<Item>      hedges;
+        size_t                 replacements = 0;
+
+        int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        for (uint32_t i = 0; i < calls_.capacity(); ++i) {
+            Call& call = calls_[i];
+            lock_t call_lock(call.mutex);
+            if (!call.started) {
+                continue;
+            }
+
+            int64_t running = now - call.started;
+            if (!call.flagged && watchdog_->stuck(running)) {
+                call.flagged = true;
+                stuck.push_back(StuckCall{
+                    call.thread,
+                    std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::nanoseconds(running)
+                    )
+                });
+                if (policy.replace_stuck && !executor_) {
+                    call.replaced = true;
+                    ++replacements;
+                }
+            }
+            if (call.hedge && watchdog_->should_hedge(running)) {
+                hedges.push_back(std::move(*call.hedge));
+                call.hedge.reset();
+            }
+        }
+
+        stuck_.fetch_add(stuck.size(), std::memory_order_relaxed);
+        replaced_.fetch_add(replacements, std::memory_order_relaxed);
+        hedged_.fetch_add(hedges.size(), std::memory_order_relaxed);
+        for (const auto& call : stuck) {
+            watchdog_->report(call);
+        }
+
+        // stop() may be joining threads_ already
+        lock.lock();
+        if (current_state_ != STATUS_RUNNING) {
+            break;
+        }
+
+        for (auto& item : hedges) {
+            hold_(item);
+            scheduler_->push(std::move(item));
+        }
+        if (!hedges.empty()) {
+            wake_all_();
+        }
+
+        // stuck workers retire when their calls return
+        for (; replacements > 0; --replacements) {
+            ++workers_;
+            ++target_workers_;
+            ++active_threads_;
+            spawn_worker_();
+        }
+
+        join_retired_(lock);
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+uint32_t BasicResourceManager<Res, H>::begin_call_(Item& item)
+{
+    uint32_t index = calls_.acquire();
+    if (index == Slab<Call>::NONE) {
+        return index;
+    }
+
+    Call& call = calls_[index];
+    lock_t lock(call.mutex);
+    call.started = std::chrono::steady_clock::now().time_since_epoch().count();
+    call.thread = std::this_thread::get_id();
+    call.flagged = false;
+    call.replaced = false;
+
+    if constexpr (std::is_copy_constructible_v<data_t>) {
+        if (watchdog_->policy().hedge && !item.hedge) {
+            item.race = std::make_shared<std::atomic_bool>(false);
+            call.hedge.emplace(Item{
+                item.data,
+                item.slot,
+                item.received,
+                item.bytes,
+                0,
+                item.deadline,
+                item.seq,
+                item.race,
+                true
+            });
+        }
+    }
+    return index;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::end_call_(uint32_t index)
+{
+    Call& call = calls_[index];
+    lock_t lock(call.mutex);
+    int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+    int64_t took = now - call.started;
+    bool replaced = call.replaced;
+    call.started = 0;
+    call.hedge.reset();
+    lock.unlock();
+
+    calls_.release(index);
+    watchdog_->record(took);
+    return replaced;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::drained_() const
+{
+    return current_state_ == STATUS_STOPPED
+        || (current_state_ == STATUS_DRAINING && scheduler_->empty());
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::process_data_(std::stop_token token)
+{
+    using clock = std::chrono::steady_clock;
+
+    while (!token.stop_requested()) {
+        int64_t idle_since = tracer_ ? tracer_->now() : 0;
+        auto has_work = [&] {
+            return scheduler_->ready() || drained_() || workers_ > target_workers_;
+        };
+
+        lock_t lock(queue_mutex_);
+        if (wait_strategy_ == WAIT_SPIN_PARK) {
+            while (!has_work()) {
+                uint32_t seen = events_.epoch();
+                lock.unlock();
+                events_.await(seen, spin_policy_);
+                lock.lock();
+            }
+        } else {
+            cv_run_.wait(lock, has_work);
+        }
+
+        // draining workers leave only when the queue is empty
+        if (drained_()) {
+            break;
+        }
+        if (workers_ > target_workers_) {
+            --workers_;
+            retired_.push_back(std::this_thread::get_id());
+            break;
+        }
+
+        size_t lane = Scheduler<Item>::NO_LANE;
+        std::optional<Item> item = scheduler_->take(lane);
+        if (item) {
+            release_(*item);
+        }
+
+        // a lane passes one element at a time, so lanes are not batched
+        std::vector<Item> batch;
+        size_t depth = 0;
+        if (item && batcher_ && lane == Scheduler<Item>::NO_LANE) {
+            depth = scheduler_->size() + 1;
+            batch.push_back(std::move(*item));
+            item.reset();
+            take_batch_(lock, batch);
+        }
+        lock.unlock();
+
+        bool replaced = false;
+        if (!batch.empty()) {
+            cv_put_.notify_all();
+            replaced = run_batch_(batch, token, idle_since, depth);
+        } else if (item && autoscaler_) {
+            auto begin = clock::now();
+            wait_ns_.fetch_add((begin - item->received).count(), std::memory_order_relaxed);
+            waited_.fetch_add(1, std::memory_order_relaxed);
+
+            cv_put_.notify_one();
+            replaced = run_item_(std::move(*item), token, idle_since);
+            busy_ns_.fetch_add((clock::now() - begin).count(), std::memory_order_relaxed);
+        } else if (item) {
+            cv_put_.notify_one();
+            replaced = run_item_(std::move(*item), token, idle_since);
+        }
+        if (lane != Scheduler<Item>::NO_LANE) {
+            finish_lane_(lane);
+        }
+
+        // the watchdog has started another worker in place of this one
+        if (replaced) {
+            lock.lock();
+            --workers_;
+            --target_workers_;
+            retired_.push_back(std::this_thread::get_id());
+            break;
+        }
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::has_space_(size_t bytes) const
+{
+    if (scheduler_->size() >= max_queue_size_) {
+        return false;
+    }
+    size_t held = bytes_.load(std::memory_order_relaxed);
+    return max_bytes_ == 0 || held == 0 || held + std::max<size_t>(bytes, 1) <= max_bytes_;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+typename BasicResourceManager<Res, H>::Item
+BasicResourceManager<Res, H>::make_item_(data_t&& data)
+{
+    size_t bytes = footprint_(data);
+    uint64_t trace_id = tracer_ ? tracer_->sample() : 0;
+    time_point_t deadline = deadline_of_ ? deadline_of_(data) : time_point_t::max();
+    return Item{
+        std::move(data),
+        pool_t::NONE,
+        std::chrono::steady_clock::now(),
+        bytes,
+        trace_id,
+        deadline,
+        0,
+        nullptr,
+        false
+    };
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::hold_(const Item& item)
+{
+    bytes_.fetch_add(item.bytes, std::memory_order_relaxed);
+    held_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::release_(const Item& item)
+{
+    bytes_.fetch_sub(item.bytes, std::memory_order_relaxed);
+    held_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::push_(Item&& item)
+{
+    uint64_t trace_id = item.trace_id;
+
+    // the wait before get_data() could not know the element's size
+    lock_t lock(queue_mutex_);
+    cv_put_.wait(
+        lock,
+        [&] { return has_space_(item.bytes) || current_state_ != STATUS_RUNNING; }
+    );
+    hold_(item);
+    scheduler_->push(std::move(item));
+    lock.unlock();
+
+    if (trace_id) {
+        tracer_->async_begin("queued", trace_id, "receiver");
+    }
+    wake_one_();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::wake_one_()
+{
+    if (executor_) {
+        executor_->notify(runner_);
+    } else if (wait_strategy_ == WAIT_SPIN_PARK) {
+        events_.notify_one();
+    } else {
+        cv_run_.notify_one();
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::wake_all_()
+{
+    cv_run_.notify_all();
+    events_.notify_all();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::run_one_()
+{
+    int64_t idle_since = tracer_ ? tracer_->now() : 0;
+
+    lock_t lock(queue_mutex_);
+    if (drained_() || !scheduler_->ready()) {
+        return false;
+    }
+
+    size_t lane = Scheduler<Item>::NO_LANE;
+    std::optional<Item> item = scheduler_->take(lane);
+    if (item) {
+        release_(*item);
+    }
+    ++in_flight_;
+    lock.unlock();
+
+    if (item) {
+        cv_put_.notify_one();
+        run_item_(std::move(*item), stop_source_.get_token(), idle_since);
+    }
+    if (lane != Scheduler<Item>::NO_LANE) {
+        finish_lane_(lane);
+    }
+
+    lock.lock();
+    --in_flight_;
+    exit_executor_();
+    return item.has_value();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::exit_executor_()
+{
+    // called with queue_mutex_ held
+    if (executor_share_ && in_flight_ == 0 && drained_()) {
+        executor_share_ = false;
+        if (--active_threads_ == 0) {
+            cv_done_.notify_all();
+        }
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::detach_()
+{
+    if (attached_) {
+        executor_->detach(runner_);
+        attached_ = false;
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::finish_lane_(size_t lane)
+{
+    lock_t lock(queue_mutex_);
+    scheduler_->done(lane);
+    bool ready = scheduler_->ready();
+    bool drained = current_state_ == STATUS_DRAINING && scheduler_->empty();
+    lock.unlock();
+
+    if (drained) {
+        wake_all_();
+    } else if (ready) {
+        wake_one_();
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::run_item_(
+    Item&& item,
+    std::stop_token token,
+    int64_t idle_since
+)
+{
+    // a hedged copy is not needed once the original has finished
+    if (item.hedge && item.race->load(std::memory_order_acquire)) {
+        return false;
+    }
+
+    uint32_t call = watchdog_ ? begin_call_(item) : Slab<Call>::NONE;
+
+    uint64_t trace_id = item.trace_id;
+    if (!trace_id) {
+        process_item_(std::move(item), token);
+    } else {
+        int64_t begin = tracer_->now();
+        tracer_->async_end("queued", trace_id, "worker");
+        tracer_->complete("idle", trace_id, idle_since, begin, "worker");
+        process_item_(std::move(item), token);
+        tracer_->complete("process", trace_id, begin, tracer_->now(), "worker");
+    }
+
+    return call != Slab<Call>::NONE && end_call_(call);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::take_batch_(lock_t& lock, std::vector<Item>& batch)
+{
+    // called with queue_mutex_ held and the first element taken
+    size_t limit = batch_limit_.load(std::memory_order_relaxed);
+    auto until = std::chrono::steady_clock::now()
+        + std::chrono::nanoseconds(linger_ns_.load(std::memory_order_relaxed));
+
+    while (batch.size() < limit) {
+        if (scheduler_->ready()) {
+            size_t lane = Scheduler<Item>::NO_LANE;
+            std::optional<Item> item = scheduler_->take(lane);
+            if (!item) {
+                break;
+            }
+            release_(*item);
+            batch.push_back(std::move(*item));
+            continue;
+        }
+        if (current_state_ != STATUS_RUNNING || std::chrono::steady_clock::now() >= until) {
+            break;
+        }
+
+        // producers wake spinning workers through events_, so poll
+        if (wait_strategy_ == WAIT_SPIN_PARK) {
+            lock.unlock();
+            std::this_thread::yield();
+            lock.lock();
+        } else {
+            cv_run_.wait_until(lock, until, [&] {
+                return scheduler_->ready() || current_state_ != STATUS_RUNNING;
+            });
+        }
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::run_batch_(
+    std::vector<Item>& batch,
+    std::stop_token token,
+    int64_t idle_since,
+    size_t depth
+)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto begin = clock::now();
+    if (autoscaler_) {
+        for (const auto& item : batch) {
+            wait_ns_.fetch_add((begin - item.received).count(), std::memory_order_relaxed);
+        }
+        waited_.fetch_add(batch.size(), std::memory_order_relaxed);
+    }
+    batches_.fetch_add(1, std::memory_order_relaxed);
+
+    // receipt times, then latencies
+    std::vector<int64_t> latencies;
+    latencies.reserve(batch.size());
+    for (const auto& item : batch) {
+        latencies.push_back(item.received.time_since_epoch().count());
+    }
+
+    bool replaced = false;
+    bool batched = false;
+    if constexpr (BatchHandlerFor<H, data_t>) {
+        if (!watchdog_) {
+            call_batch_(batch, token);
+            batched = true;
+        }
+    }
+
+    if (batched) {
+        int64_t now = clock::now().time_since_epoch().count();
+        for (auto& latency : latencies) {
+            latency = now - latency;
+        }
+    } else {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            // elements not started yet stay for saving once stopped
+            if (current_state_ == STATUS_STOPPED) {
+                lock_t lock(queue_mutex_);
+                for (size_t j = i; j < batch.size(); ++j) {
+                    hold_(batch[j]);
+                    scheduler_->push(std::move(batch[j]));
+                }
+                latencies.resize(i);
+                break;
+            }
+            replaced |= run_item_(std::move(batch[i]), token, idle_since);
+            latencies[i] = clock::now().time_since_epoch().count() - latencies[i];
+        }
+    }
+
+    int64_t service_ns = (clock::now() - begin).count();
+    if (autoscaler_) {
+        busy_ns_.fetch_add(service_ns, std::memory_order_relaxed);
+    }
+    sample_batch_(service_ns, latencies, depth);
+    return replaced;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::call_batch_(std::vector<Item>& batch, std::stop_token token)
+{
+    std::vector<Item>              ready;
+    std::vector<std::vector<Item>> followers;
+    std::vector<data_t>            data;
+    std::vector<uint64_t>          traced;
+
+    auto now = std::chrono::steady_clock::now();
+    for (auto& item : batch) {
+        std::vector<Item> merged;
+        if (coalescer_) {
+            merged = coalescer_->release(item);
+        }
+
+        if (deadline_of_ && item.deadline < now) {
+            expired_.fetch_add(1 + merged.size(), std::memory_order_relaxed);
+            drop_(item);
+            for (auto& x : merged) {
+                drop_(x);
+            }
+            continue;
+        }
+        if (limit_point_ == LIMIT_AT_DISPATCH && !admit_(item, merged)) {
+            continue;
+        }
+
+        if (item.trace_id) {
+            tracer_->async_end("queued", item.trace_id, "worker");
+            traced.push_back(item.trace_id);
+        }
+        data.push_back(std::move(item.data));
+        ready.push_back(std::move(item));
+        followers.push_back(std::move(merged));
+    }
+    if (ready.empty()) {
+        return;
+    }
+
+    auto call = [&]() -> decltype(auto) {
+        if constexpr (requires { handler_.process_batch(std::move(data), token); }) {
+            return handler_.process_batch(std::move(data), token);
+        } else {
+            return handler_.process_batch(std::move(data));
+        }
+    };
+
+    int64_t begin = traced.empty() ? 0 : tracer_->now();
+    try {
+        if constexpr (std::is_void_v<result_t>) {
+            call();
+            for (size_t i = 0; i < ready.size(); ++i) {
+                complete_(ready[i], followers[i], std::monostate());
+            }
+        } else {
+            auto results = call();
+            for (size_t i = 0; i < ready.size(); ++i) {
+                complete_(ready[i], followers[i], std::move(results[i]));
+            }
+        }
+    } catch (const OperationCancelled&) {
+        // a cancelled handler leaves the elements in place
+        for (size_t i = 0; i < ready.size(); ++i) {
+            ready[i].data = std::move(data[i]);
+            requeue_(std::move(ready[i]), followers[i]);
+        }
+    }
+
+    for (uint64_t trace_id : traced) {
+        tracer_->complete("process", trace_id, begin, tracer_->now(), "worker");
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::sample_batch_(
+    int64_t service_ns,
+    const std::vector<int64_t>& latencies,
+    size_t depth
+)
+{
+    using clock = std::chrono::steady_clock;
+
+    lock_t lock(batch_mutex_);
+    latencies_.insert(latencies_.end(), latencies.begin(), latencies.end());
+    service_ns_ += service_ns;
+    sampled_ += latencies.size();
+
+    auto now = clock::now();
+    if (now - decided_ < batcher_->policy().interval) {
+        return;
+    }
+
+    double p99_ms = 0;
+    if (!latencies_.empty()) {
+        auto at = latencies_.begin() + static_cast<ptrdiff_t>((latencies_.size() - 1) * 99 / 100);
+        std::nth_element(latencies_.begin(), at, latencies_.end());
+        p99_ms = static_cast<double>(*at) / 1e6;
+    }
+
+    uint64_t received = received_.load(std::memory_order_relaxed);
+    double elapsed = std::chrono::duration<double>(now - decided_).count();
+    BatchSample sample{
+        static_cast<double>(received - arrivals_) / elapsed,
+        depth,
+        sampled_ ? static_cast<double>(service_ns_) / 1e3 / static_cast<double>(sampled_) : 0,
+        p99_ms
+    };
+
+    BatchDecision decision = batcher_->decide(sample);
+    batch_limit_.store(decision.batch, std::memory_order_relaxed);
+    linger_ns_.store(
+        std::chrono::nanoseconds(decision.linger).count(),
+        std::memory_order_relaxed
+    );
+
+    latencies_.clear();
+    service_ns_ = 0;
+    sampled_ = 0;
+    arrivals_ = received;
+    decided_ = now;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::process_item_(Item&& item, std::stop_token token)
+{
+    std::vector<Item> followers;
+    if (coalescer_ && !item.hedge) {
+        followers = coalescer_->release(item);
+    }
+
+    if (deadline_of_ && item.deadline < std::chrono::steady_clock::now()) {
+        expired_.fetch_add(1 + followers.size(), std::memory_order_relaxed);
+        drop_(item);
+        for (auto& x : followers) {
+            drop_(x);
+        }
+        return;
+    }
+
+    if (limit_point_ == LIMIT_AT_DISPATCH && !admit_(item, followers)) {
+        return;
+    }
+
+    auto call = [&]() -> decltype(auto) {
+        if constexpr (CancellableHandlerFor<H, data_t>) {
+            return handler_.process(std::move(item.data), token);
+        } else {
+            return handler_.process(std::move(item.data));
+        }
+    };
+
+    try {
+        if constexpr (std::is_void_v<result_t>) {
+            call();
+            complete_(item, followers, std::monostate());
+        } else {
+            complete_(item, followers, call());
+        }
+    } catch (const OperationCancelled&) {
+        requeue_(std::move(item), followers);
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::requeue_(Item&& item, std::vector<Item>& followers)
+{
+    // a requeued element leaves its hedged pair, so the pair is never
+    // saved twice: a cancelled copy is given up, the original takes
+    // the element back unless the copy has already completed it
+    bool keep = !item.hedge;
+    if (keep && item.race) {
+        keep = !item.race->exchange(true, std::memory_order_acq_rel);
+        item.race.reset();
+    }
+
+    lock_t lock(queue_mutex_);
+    requeued_count_.fetch_add(keep + followers.size(), std::memory_order_relaxed);
+    if (late_backup_) {
+        // a straggler after the session has been saved
+        if (keep) {
+            save_(std::move(item), *late_backup_);
+        }
+        for (auto& x : followers) {
+            save_(std::move(x), *late_backup_);
+        }
+        return;
+    }
+
+    if (keep) {
+        hold_(item);
+        requeued_.emplace(std::move(item));
+    }
+    for (auto& x : followers) {
+        hold_(x);
+        requeued_.emplace(std::move(x));
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::complete_(
+    Item& item,
+    std::vector<Item>& followers,
+    value_t&& result
+)
+{
+    // the loser of a hedged pair leaves the handle to the winner
+    bool first = !item.race || !item.race->exchange(true, std::memory_order_acq_rel);
+    if (first) {
+        processed_.fetch_add(1, std::memory_order_relaxed);
+        if (latency_) {
+            latency_->add((std::chrono::steady_clock::now() - item.received).count());
+        }
+        // both copies carry the seq, the element is acked once
+        ack_(item);
+    }
+
+    for (auto& x : followers) {
+        ack_(x);
+        if (x.slot != pool_t::NONE) {
+            if constexpr (std::is_copy_constructible_v<value_t>) {
+                completions_.complete(x.slot, value_t(result));
+            } else {
+                completions_.drop(x.slot);
+            }
+        }
+        coalescer_->fan_out(std::move(x));
+    }
+
+    if (first && item.slot != pool_t::NONE) {
+        completions_.complete(item.slot, std::move(result));
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::drop_(Item& item)
+{
+    // a hedged copy never finishes the handle, the original does
+    // unless the copy has already completed and acked the element
+    bool lost = !item.hedge && item.race && item.race->exchange(true, std::memory_order_acq_rel);
+    if (item.hedge || lost) {
+        item.slot = pool_t::NONE;
+    }
+    if (item.slot != pool_t::NONE) {
+        completions_.drop(item.slot);
+        item.slot = pool_t::NONE;
+    }
+    if (!item.hedge && !lost) {
+        ack_(item);
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::journal_item_(Item& item)
+{
+    thread_local std::string record;
+    record.clear();
+    encode_(item.data, record);
+    item.seq = journal_->append(record);
+
+    // concurrent submitters share one sync
+    if (journal_->options().wait_for_sync) {
+        journal_->wait_durable(item.seq);
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::journal_unchecked_(Item& item)
+{
+    // threads with nobody to report to go on without durability,
+    // journal_error() tells
+    try {
+        journal_item_(item);
+    } catch (const std::system_error&) { }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::ack_(const Item& item)
+{
+    if (item.seq) {
+        journal_->ack(item.seq);
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+bool BasicResourceManager<Res, H>::admit_(Item& item, std::vector<Item>& followers)
+{
+    if (!limiter_) {
+        return true;
+    }
+
+    if (over_limit_ == OVER_LIMIT_DELAY) {
+        auto at = limiter_->reserve(item.data);
+        if (at <= std::chrono::steady_clock::now()) {
+            return true;
+        }
+        delayed_.fetch_add(1, std::memory_order_relaxed);
+
+        // the receiver gives up waiting when the manager stops running,
+        // workers only when it is stopped, then the element is kept
+        lock_t lock(queue_mutex_);
+        bool interrupted = cv_state_.wait_until(lock, at, [&] {
+            return limit_point_ == LIMIT_AT_DISPATCH
+                ? current_state_ == STATUS_STOPPED
+                : current_state_ != STATUS_RUNNING;
+        });
+        lock.unlock();
+
+        if (interrupted && limit_point_ == LIMIT_AT_DISPATCH) {
+            requeue_(std::move(item), followers);
+            return false;
+        }
+        return true;
+    }
+
+    if (limiter_->try_acquire(item.data)) {
+        return true;
+    }
+
+    auto& counter = over_limit_ == OVER_LIMIT_REJECT ? rejected_ : overflowed_;
+    counter.fetch_add(1 + followers.size(), std::memory_order_relaxed);
+
+    followers.insert(followers.begin(), std::move(item));
+    for (auto& x : followers) {
+        drop_(x);
+        if (over_limit_ == OVER_LIMIT_OVERFLOW && on_overflow_) {
+            on_overflow_(std::move(x.data));
+        }
+    }
+    return false;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+ManagerStats BasicResourceManager<Res, H>::stats() const
+{
+    size_t n_of_threads = autoscaler_ && !executor_ && current_state_ == STATUS_RUNNING
+        ? workers_.load(std::memory_order_relaxed) + 1
+        : n_of_threads_;
+
+    return ManagerStats{
+        n_of_threads,
+        held_.load(std::memory_order_relaxed),
+        received_.load(std::memory_order_relaxed),
+        processed_.load(std::memory_order_relaxed),
+        coalesced_.load(std::memory_order_relaxed),
+        requeued_count_.load(std::memory_order_relaxed),
+        rejected_.load(std::memory_order_relaxed),
+        delayed_.load(std::memory_order_relaxed),
+        overflowed_.load(std::memory_order_relaxed),
+        expired_.load(std::memory_order_relaxed),
+        stuck_.load(std::memory_order_relaxed),
+        replaced_.load(std::memory_order_relaxed),
+        hedged_.load(std::memory_order_relaxed),
+        replayed_.load(std::memory_order_relaxed),
+        journal_ ? journal_->syncs() : 0,
+        batches_.load(std::memory_order_relaxed),
+        batch_limit_.load(std::memory_order_relaxed),
+        static_cast<uint64_t>(linger_ns_.load(std::memory_order_relaxed) / 1000),
+        scale_ups_.load(std::memory_order_relaxed),
+        scale_downs_.load(std::memory_order_relaxed),
+        bytes_.load(std::memory_order_relaxed),
+        backup_.load(std::memory_order_relaxed),
+        backup_bytes_.load(std::memory_order_relaxed)
+    };
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::enable_latency_histogram()
+{ latency_ = std::make_unique<DurationHistogram>(); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+const DurationHistogram* BasicResourceManager<Res, H>::latency() const
+{ return latency_.get(); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+template <class KeyOf, class OnMerged>
+void BasicResourceManager<Res, H>::enable_coalescing(KeyOf key_of, OnMerged on_merged)
+{
+    auto key = [key_of = std::move(key_of)](const Item& x) mutable {
+        return key_of(x.data);
+    };
+    auto merge = [on_merged = std::move(on_merged)](Item&& x) mutable {
+        on_merged(std::move(x.data));
+    };
+    coalescer_ = std::make_unique<KeyedCoalescer<Item, decltype(key), decltype(merge)>>(
+        std::move(key), std::move(merge)
+    );
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+template <class KeyOf>
+void BasicResourceManager<Res, H>::enable_partitioning(KeyOf key_of, size_t n_of_lanes)
+{
+    auto key = [key_of = std::move(key_of)](const Item& x) mutable {
+        return key_of(x.data);
+    };
+    using key_t = std::remove_cvref_t<std::invoke_result_t<KeyOf&, const data_t&>>;
+    using scheduler_t = PartitionedScheduler<Item, decltype(key), std::hash<key_t>>;
+
+    replace_scheduler_(std::make_unique<scheduler_t>(std::move(key), n_of_lanes));
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+template <class DeadlineOf>
+void BasicResourceManager<Res, H>::enable_deadlines(DeadlineOf deadline_of)
+{
+    deadline_of_ = std::move(deadline_of);
+
+    auto deadline = [](const Item& x) { return x.deadline; };
+    replace_scheduler_(std::make_unique<EdfScheduler<Item, decltype(deadline)>>(deadline));
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::replace_scheduler_(std::unique_ptr<Scheduler<Item>> scheduler)
+{
+    if (monitor_) {
+        scheduler = std::make_unique<MonitoredScheduler<Item>>(std::move(scheduler), *monitor_);
+    }
+    while (auto item = scheduler_->take_any()) {
+        scheduler->push(std::move(*item));
+    }
+    scheduler_ = std::move(scheduler);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+template <class ClassOf, class KeyOf>
+void BasicResourceManager<Res, H>::enable_monitoring(
+    ClassOf class_of,
+    KeyOf key_of,
+    MonitorOptions options
+)
+{
+    monitor_ = std::make_unique<PendingMonitor<Item>>(
+        [class_of = std::move(class_of)](const Item& x) mutable {
+            return static_cast<size_t>(class_of(x.data));
+        },
+        [key_of = std::move(key_of)](const Item& x) mutable {
+            return static_cast<uint64_t>(key_of(x.data));
+        },
+        [](const Item& x) { return x.received; },
+        options
+    );
+
+    Queue<Item> pending;
+    while (auto item = scheduler_->take_any()) {
+        pending.emplace(std::move(*item));
+    }
+    scheduler_ = std::make_unique<MonitoredScheduler<Item>>(std::move(scheduler_), *monitor_);
+    while (!pending.empty()) {
+        scheduler_->push(pending.take_first());
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+PendingSnapshot BasicResourceManager<Res, H>::pending_snapshot(size_t top_n) const
+{
+    if (!monitor_) {
+        return PendingSnapshot{};
+    }
+    return monitor_->snapshot(top_n);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::limit_rate(
+    std::shared_ptr<RateLimiter<data_t>> limiter,
+    LimitPoint point,
+    OverLimit action,
+    std::function<void(data_t&&)> on_overflow
+)
+{
+    limiter_ = std::move(limiter);
+    limit_point_ = point;
+    over_limit_ = action;
+    on_overflow_ = std::move(on_overflow);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::use_executor(std::shared_ptr<Executor> executor)
+{
+    detach_();
+    executor_ = std::move(executor);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::enable_autoscaling(AutoscalePolicy policy)
+{ autoscaler_ = std::make_unique<Autoscaler>(policy); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::enable_batching(BatchPolicy policy)
+{
+    batcher_ = std::make_unique<BatchController>(policy);
+    batch_limit_ = 1;
+    linger_ns_ = 0;
+    arrivals_ = received_.load(std::memory_order_relaxed);
+    decided_ = std::chrono::steady_clock::now();
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::set_wait_strategy(WaitStrategy strategy, SpinPolicy policy)
+{
+    wait_strategy_ = strategy;
+    spin_policy_ = policy;
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::set_byte_budget(size_t max_bytes)
+{ set_byte_budget(max_bytes, Footprint<data_t>()); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+template <class F>
+void BasicResourceManager<Res, H>::set_byte_budget(size_t max_bytes, F footprint)
+{
+    max_bytes_ = max_bytes;
+    footprint_ = std::move(footprint);
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::enable_watchdog(
+    WatchdogPolicy policy,
+    std::function<void(const StuckCall&)> on_stuck
+)
+{ watchdog_ = std::make_unique<Watchdog>(policy, std::move(on_stuck)); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::enable_tracing(std::shared_ptr<Tracer> tracer)
+{ tracer_ = std::move(tracer); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+template <class Codec>
+void BasicResourceManager<Res, H>::enable_journal(const std::string& dir, JournalOptions options)
+{
+    journal_ = std::make_unique<Journal>(dir, options);
+    encode_ = [](const data_t& x, std::string& out) { Codec::encode(x, out); };
+
+    journal_->replay([this](uint64_t seq, std::string_view bytes) {
+        Item item = make_item_(Codec::decode(bytes));
+        item.seq = seq;
+        hold_(item);
+        scheduler_->push(std::move(item));
+        replayed_.fetch_add(1, std::memory_order_relaxed);
+    });
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+std::error_code BasicResourceManager<Res, H>::journal_error() const
+{ return journal_ ? journal_->error() : std::error_code(); }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::save_session_data(Queue<data_t>& backup)
+{
+    if (current_state_ == STATUS_RUNNING) {
+        stop();
+    }
+    flush_producers_();
+
+    lock_t lock(queue_mutex_);
+    while (!requeued_.empty()) {
+        Item item = requeued_.take_first();
+        release_(item);
+        save_(std::move(item), backup);
+    }
+    while (auto item = scheduler_->take_any()) {
+        release_(*item);
+        save_(std::move(*item), backup);
+    }
+    late_backup_ = stragglers_.empty() ? nullptr : &backup;
+    lock.unlock();
+
+    if (coalescer_) {
+        coalescer_->drain([&](Item&& item) { save_(std::move(item), backup); });
+    }
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::save_(Item&& item, Queue<data_t>& backup)
+{
+    if (item.hedge && item.race->load(std::memory_order_acquire)) {
+        return;
+    }
+    drop_(item);
+    backup_bytes_.fetch_add(item.bytes, std::memory_order_relaxed);
+    backup_.fetch_add(1, std::memory_order_relaxed);
+    backup.emplace(std::move(item.data));
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+void BasicResourceManager<Res, H>::restore_session_data(Queue<data_t>& backup)
+{
+    if (current_state_ == STATUS_RUNNING) {
+        stop();
+    }
+#ifdef __INFO_DEBUG__
+    if (max_queue_size_ < scheduler_->size() + backup.size()) {
+        WaitingQueueOverflow(
+            "Not all saved data will be processed: "
+            "there are not enough free space for restoring\n"
+        ).what();
+    }
+#endif // __INFO_DEBUG__
+    while (!backup.empty() && has_space_(footprint_(backup.front()))) {
+        Item item = make_item_(backup.take_first());
+        if (journal_) {
+            try {
+                journal_item_(item);
+            } catch (const std::system_error&) {
+                // kept for a later restore, at the back
+                backup.push(std::move(item.data));
+                throw;
+            }
+        }
+
+        size_t saved = backup_bytes_.load(std::memory_order_relaxed);
+        backup_bytes_.store(saved - std::min(saved, item.bytes), std::memory_order_relaxed);
+        size_t count = backup_.load(std::memory_order_relaxed);
+        backup_.store(count - std::min<size_t>(count, 1), std::memory_order_relaxed);
+
+        hold_(item);
+        scheduler_->push(std::move(item));
+    }
+}
+
+/// Type-erased manager working through the Resource<T> and
+/// DataHandler<T, R> interfaces; use BasicResourceManager with
+/// concrete (preferably final) types to let handlers be inlined
+template <class T, class R>
+class ResourceManager
+    : public BasicResourceManager<Resource<T>, DataHandler<T, R>>
+{
+ public:
+    using BasicResourceManager<Resource<T>, DataHandler<T, R>>::BasicResourceManager;
+};
+
+}
@@ -0,0 +1,333 @@
+#pragma once
+
+#include <system_error>
+#include <string_view>
+#include <functional>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <poll.h>
+
+#include "gendef.h"
+#include "stats.h"
+#include "lock_profiler.h"
+
+namespace gen
+{
+
+/// Collects samples and renders them in the Prometheus text format;
+/// samples of one metric are grouped under a single HELP and TYPE
+/// whatever order they are added in
+class MetricsWriter
+{
+ public:
+    /// labels are written as they are, e.g. manager="echo"
+    void counter(std::string_view name, std::string_view help, double value, std::string_view labels = {});
+    void gauge(std::string_view name, std::string_view help, double value, std::string_view labels = {});
+
+    /// In seconds, buckets from 1us to about 1 minute
+    void histogram(
+        std::string_view name,
+        std::string_view help,
+        const DurationHistogram& durations,
+        std::string_view labels = {}
+    );
+
+    std::string render() const;
+
+ private:
+    struct Family
+    {
+        std::string help;
+        std::string type;
+        std::string samples;
+    };
+
+    std::vector<std::string>      order_;
+    std::map<std::string, Family> families_;
+
+    std::string& family_(std::string_view name, std::string_view help, std::string_view type);
+    static void sample_(std::string& out, std::string_view name, std::string_view labels, double value);
+};
+
+/// Serves the output of its collectors at a Unix domain socket, one
+/// HTTP/1.0 response per connection, so curl --unix-socket or any
+/// local scraper can read it. Collectors run on the exporter's thread
+/// and should read lock-free snapshots such as ManagerStats
+class MetricsExporter
+{
+ public:
+    using collector_t = std::function<void(MetricsWriter&)>;
+
+    explicit MetricsExporter(std::string path);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+
+    /// Must be called before start()
+    void add(collector_t collector);
+
+    void start();
+    void stop();
+
+    /// What a scrape returns now
+    std::string scrape() const;
+
+    const std::string& path() const;
+
+ private:
+    const std::string        path_;
+    std::vector<collector_t> collectors_;
+    int                      fd_;
+    thread_t                 thread_;
+
+    void serve_(std::stop_token token);
+    void answer_(int client) const;
+};
+
+/// Collector of a manager's stats, labelled manager="name"; the
+/// latency histogram is included if the manager keeps one
+template <class Manager>
+MetricsExporter::collector_t manager_metrics(const Manager& manager, std::string name);
+
+inline std::string& MetricsWriter::family_(
+    std::string_view name,
+    std::string_view help,
+    std::string_view type
+)
+{
+    auto [it, added] = families_.try_emplace(std::string(name));
+    if (added) {
+        order_.emplace_back(name);
+        it->second.help = help;
+        it->second.type = type;
+    }
+    return it->second.samples;
+}
+
+inline void MetricsWriter::sample_(
+    std::string& out,
+    std::string_view name,
+    std::string_view labels,
+    double value
+)
+{
+    char number[32];
+    std::snprintf(number, sizeof(number), "%.17g", value);
+
+    out.append(name);
+    if (!labels.empty()) {
+        out.append("{").append(labels).append("}");
+    }
+    out.append(" ").append(number).append("\n");
+}
+
+inline void MetricsWriter::counter(
+    std::string_view name,
+    std::string_view help,
+    double value,
+    std::string_view labels
+)
+{ sample_(family_(name, help, "counter"), name, labels, value); }
+
+inline void MetricsWriter::gauge(
+    std::string_view name,
+    std::string_view help,
+    double value,
+    std::string_view labels
+)
+{ sample_(family_(name, help, "gauge"), name, labels, value); }
+
+inline void MetricsWriter::histogram(
+    std::string_view name,
+    std::string_view help,
+    const DurationHistogram& durations,
+    std::string_view labels
+)
+{
+    // 2^10 ns is about 1us, 2^36 ns about a minute
+    constexpr size_t FIRST = 9;
+    constexpr size_t LAST = 35;
+
+    std::string& out = family_(name, help, "histogram");
+    std::string bucket = std::string(name) + "_bucket";
+    std::string separator = labels.empty() ? "" : ",";
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < DurationHistogram::N_OF_BUCKETS; ++i) {
+        seen += durations.bucket(i);
+        if (i < FIRST || i > LAST) {
+            continue;
+        }
+        char le[48];
+        std::snprintf(le, sizeof(le), "le=\"%.9g\"", static_cast<double>(int64_t(1) << (i + 1)) / 1e9);
+        sample_(out, bucket, std::string(labels) + separator + le, static_cast<double>(seen));
+    }
+    sample_(out, bucket, std::string(labels) + separator + "le=\"+Inf\"", static_cast<double>(seen));
+    sample_(out, std::string(name) + "_sum", labels, static_cast<double>(durations.total()) / 1e9);
+    sample_(out, std::string(name) + "_count", labels, static_cast<double>(seen));
+}
+
+inline std::string MetricsWriter::render() const
+{
+    std::string out;
+    for (const auto& name : order_) {
+        const Family& family = families_.at(name);
+        out.append("# HELP ").append(name).append(" ").append(family.help).append("\n");
+        out.append("# TYPE ").append(name).append(" ").append(family.type).append("\n");
+        out.append(family.samples);
+    }
+    return out;
+}
+
+inline MetricsExporter::MetricsExporter(std::string path)
+    : path_(std::move(path)),
+      fd_(-1)
+{ }
+
+inline MetricsExporter::~MetricsExporter()
+{ stop(); }
+
+inline void MetricsExporter::add(collector_t collector)
+{ collectors_.push_back(std::move(collector)); }
+
+inline const std::string& MetricsExporter::path() const
+{ return path_; }
+
+inline std::string MetricsExporter::scrape() const
+{
+    MetricsWriter writer;
+    for (const auto& collect : collectors_) {
+        collect(writer);
+    }
+    return writer.render();
+}
+
+inline void MetricsExporter::start()
+{
+    sockaddr_un address{};
+    if (path_.size() >= sizeof(address.sun_path)) {
+        throw std::system_error(ENAMETOOLONG, std::generic_category(), path_);
+    }
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, path_.c_str(), path_.size() + 1);
+
+    fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd_ < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket");
+    }
+
+    ::unlink(path_.c_str());
+    if (::bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+        || ::listen(fd_, 16) != 0) {
+        int error = errno;
+        ::close(fd_);
+        fd_ = -1;
+        throw std::system_error(error, std::generic_category(), "bind " + path_);
+    }
+
+    thread_ = thread_t([this](std::stop_token token) { serve_(token); });
+}
+
+inline void MetricsExporter::stop()
+{
+    if (fd_ < 0) {
+        return;
+    }
+    thread_.request_stop();
+    thread_.join();
+    ::close(fd_);
+    ::unlink(path_.c_str());
+    fd_ = -1;
+}
+
+inline void MetricsExporter::serve_(std::stop_token token)
+{
+    // polled with a timeout to notice stop requests
+    while (!token.stop_requested()) {
+        pollfd listener{fd_, POLLIN, 0};
+        if (::poll(&listener, 1, 100) <= 0) {
+            continue;
+        }
+        int client = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client >= 0) {
+            answer_(client);
+            ::close(client);
+        }
+    }
+}
+
+inline void MetricsExporter::answer_(int client) const
+{
+    // the request is read up to its blank line but not interpreted,
+    // a client sending nothing gets the answer after 100 ms
+    std::string request;
+    char block[1024];
+    while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+        pollfd peer{client, POLLIN, 0};
+        if (::poll(&peer, 1, 100) <= 0) {
+            break;
+        }
+        ssize_t n = ::recv(client, block, sizeof(block), 0);
+        if (n <= 0) {
+            break;
+        }
+        request.append(block, static_cast<size_t>(n));
+    }
+
+    std::string body = scrape();
+    std::string response =
+        "HTTP/1.0 200 OK\r\n"
+        "Content-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " + std::to_string(body.size()) + "\r\n"
+        "\r\n" + body;
+
+    const char* data = response.data();
+    size_t left = response.size();
+    while (left > 0) {
+        ssize_t n = ::send(client, data, left, MSG_NOSIGNAL);
+        if (n <= 0) {
+            break;
+        }
+        data += n;
+        left -= static_cast<size_t>(n);
+    }
+}
+
+template <class Manager>
+MetricsExporter::collector_t manager_metrics(const Manager& manager, std::string name)
+{
+    return [&manager, labels = "manager=\"" + name + "\""](MetricsWriter& out) {
+        ManagerStats s = manager.stats();
+        auto d = [](auto x) { return static_cast<double>(x); };
+
+        out.gauge("gen_pending", "Elements waiting in the queue", d(s.pending), labels);
+        out.gauge("gen_pending_bytes", "Footprint of waiting elements", d(s.bytes), labels);
+        out.gauge("gen_threads", "Threads of the manager", d(s.n_of_threads), labels);
+        out.gauge("gen_backup", "Elements saved to backups, not restored", d(s.backup), labels);
+        out.gauge("gen_backup_bytes", "Footprint of saved elements", d(s.backup_bytes), labels);
+        out.gauge("gen_batch_size", "Current batch limit", d(s.batch_size), labels);
+
+        out.counter("gen_received_total", "Elements received", d(s.received), labels);
+        out.counter("gen_processed_total", "Elements processed", d(s.processed), labels);
+        out.counter("gen_coalesced_total", "Elements merged into waiting ones", d(s.coalesced), labels);
+        out.counter("gen_requeued_total", "Elements given up by cancelled handlers", d(s.requeued), labels);
+        out.counter("gen_dropped_total", "Elements dropped", d(s.rejected), labels + ",reason=\"rejected\"");
+        out.counter("gen_dropped_total", "Elements dropped", d(s.overflowed), labels + ",reason=\"overflowed\"");
+        out.counter("gen_dropped_total", "Elements dropped", d(s.expired), labels + ",reason=\"expired\"");
+        out.counter("gen_stuck_total", "Handler calls flagged as stuck", d(s.stuck), labels);
+        out.counter("gen_scale_ups_total", "Workers added by autoscaling", d(s.scale_ups), labels);
+        out.counter("gen_scale_downs_total", "Workers removed by autoscaling", d(s.scale_downs), labels);
+
+        if (const DurationHistogram* latency = manager.latency()) {
+            out.histogram("gen_latency_seconds", "Time from receipt to completion", *latency, labels);
+        }
+    };
+}
+
+}
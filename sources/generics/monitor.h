@@ -0,0 +1,364 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "stats.h"
+#include "gendef.h"
+#include "scheduler.h"
+
+namespace gen
+{
+
+struct MonitorOptions
+{
+    size_t n_of_classes;
+
+    // distinct keys tracked for the top, the rest are not reported
+    size_t n_of_keys = 1024;
+
+    // resolution of the oldest element age, ages up to
+    // granularity * 1024 are exact, older ones are reported
+    // as the age of the oldest element seen since they folded
+    std::chrono::milliseconds granularity = std::chrono::milliseconds(10);
+};
+
+/// Summary of pending elements: count per class, age of the oldest one
+/// and counts per key. Writers must be serialized (the manager calls
+/// them under its queue mutex) and publish through a sequence counter,
+/// readers copy the summary without locking and retry if a writer
+/// changed it meanwhile
+template <class T>
+class PendingMonitor
+{
+ public:
+    using clock = std::chrono::steady_clock;
+
+    PendingMonitor(
+        std::function<size_t(const T&)> class_of,
+        std::function<uint64_t(const T&)> key_of,
+        std::function<clock::time_point(const T&)> received_of,
+        MonitorOptions options
+    );
+
+    PendingMonitor(const PendingMonitor&) = delete;
+
+    void add(const T& x);
+    void remove(const T& x);
+
+    PendingSnapshot snapshot(size_t top_n) const;
+
+ private:
+    static constexpr size_t   N_OF_BUCKETS = 1024;
+    static constexpr int64_t  NO_BUCKET = INT64_MAX;
+    static constexpr uint64_t NO_KEY = UINT64_MAX;
+    static constexpr size_t   MAX_ATTEMPTS = 16;
+
+    struct Bucket
+    {
+        std::atomic<int64_t> id{NO_BUCKET};
+        std::atomic<size_t>  count{0};
+    };
+
+    struct KeyCount
+    {
+        std::atomic<uint64_t> key{NO_KEY};
+        std::atomic<size_t>   count{0};
+    };
+
+    std::function<size_t(const T&)>            class_of_;
+    std::function<uint64_t(const T&)>          key_of_;
+    std::function<clock::time_point(const T&)> received_of_;
+
+    clock::time_point         origin_;
+    std::chrono::milliseconds granularity_;
+
+    std::atomic<uint64_t>            sequence_;
+    std::atomic<size_t>              pending_;
+    std::vector<std::atomic<size_t>> per_class_;
+    std::vector<Bucket>              buckets_;
+    std::vector<KeyCount>            keys_;
+
+    // elements whose bucket was reused while they were pending
+    std::atomic<size_t>  stale_count_;
+    std::atomic<int64_t> stale_oldest_;
+
+    int64_t bucket_of_(const T& x) const;
+    void update_(const T& x, bool add);
+    void count_key_(uint64_t key, bool add);
+    void age_(int64_t id, bool add);
+
+    static void bump_(std::atomic<size_t>& counter, bool add);
+};
+
+/// Scheduler reporting its elements to a monitor
+template <class T>
+class MonitoredScheduler final : public Scheduler<T>
+{
+ public:
+    MonitoredScheduler(std::unique_ptr<Scheduler<T>> scheduler, PendingMonitor<T>& monitor);
+
+    void push(T&& x) override;
+
+    std::optional<T> take(size_t& lane) override;
+    void done(size_t lane) override;
+
+    std::optional<T> take_any() override;
+
+    bool ready() const override;
+    size_t size() const override;
+    bool empty() const override;
+
+ private:
+    std::unique_ptr<Scheduler<T>> scheduler_;
+    PendingMonitor<T>&            monitor_;
+};
+
+template <class T>
+PendingMonitor<T>::PendingMonitor(
+    std::function<size_t(const T&)> class_of,
+    std::function<uint64_t(const T&)> key_of,
+    std::function<clock::time_point(const T&)> received_of,
+    MonitorOptions options
+)
+    : class_of_(std::move(class_of)),
+      key_of_(std::move(key_of)),
+      received_of_(std::move(received_of)),
+      origin_(clock::now()),
+      granularity_(std::max(options.granularity, std::chrono::milliseconds(1))),
+      sequence_(0),
+      pending_(0),
+      per_class_(options.n_of_classes),
+      buckets_(N_OF_BUCKETS),
+      keys_(options.n_of_keys ? options.n_of_keys : 1),
+      stale_count_(0),
+      stale_oldest_(NO_BUCKET)
+{ }
+
+template <class T>
+int64_t PendingMonitor<T>::bucket_of_(const T& x) const
+{ return (received_of_(x) - origin_) / granularity_; }
+
+template <class T>
+void PendingMonitor<T>::bump_(std::atomic<size_t>& counter, bool add)
+{
+    size_t value = counter.load(std::memory_order_relaxed);
+    counter.store(add ? value + 1 : value - 1, std::memory_order_relaxed);
+}
+
+template <class T>
+void PendingMonitor<T>::add(const T& x)
+{ update_(x, true); }
+
+template <class T>
+void PendingMonitor<T>::remove(const T& x)
+{ update_(x, false); }
+
+template <class T>
+void PendingMonitor<T>::update_(const T& x, bool add)
+{
+    // odd sequence tells readers that an update is in progress
+    uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    bump_(pending_, add);
+
+    size_t cls = class_of_(x);
+    if (cls < per_class_.size()) {
+        bump_(per_class_[cls], add);
+    }
+    count_key_(key_of_(x), add);
+    age_(bucket_of_(x), add);
+
+    sequence_.store(sequence + 2, std::memory_order_release);
+}
+
+template <class T>
+void PendingMonitor<T>::count_key_(uint64_t key, bool add)
+{
+    size_t start = std::hash<uint64_t>()(key) % keys_.size();
+    KeyCount* free_slot = nullptr;
+
+    // the writer is single, so a key is in at most one slot: a slot is
+    // reused only when the whole probe sequence has no slot for the key
+    for (size_t i = 0; i < keys_.size(); ++i) {
+        KeyCount& slot = keys_[(start + i) % keys_.size()];
+        uint64_t slot_key = slot.key.load(std::memory_order_relaxed);
+
+        if (slot_key == key) {
+            if (add || slot.count.load(std::memory_order_relaxed)) {
+                bump_(slot.count, add);
+            }
+            return;
+        }
+        if (!free_slot && slot.count.load(std::memory_order_relaxed) == 0) {
+            free_slot = &slot;
+        }
+        if (slot_key == NO_KEY) {
+            break;
+        }
+    }
+
+    if (add && free_slot) {
+        free_slot->key.store(key, std::memory_order_relaxed);
+        free_slot->count.store(1, std::memory_order_relaxed);
+    }
+}
+
+template <class T>
+void PendingMonitor<T>::age_(int64_t id, bool add)
+{
+    Bucket& bucket = buckets_[static_cast<size_t>(id) % N_OF_BUCKETS];
+    int64_t bucket_id = bucket.id.load(std::memory_order_relaxed);
+
+    if (add && bucket_id < id) {
+        size_t count = bucket.count.load(std::memory_order_relaxed);
+        if (count) {
+            stale_count_.store(
+                stale_count_.load(std::memory_order_relaxed) + count,
+                std::memory_order_relaxed
+            );
+            stale_oldest_.store(
+                std::min(stale_oldest_.load(std::memory_order_relaxed), bucket_id),
+                std::memory_order_relaxed
+            );
+        }
+        bucket.id.store(bucket_id = id, std::memory_order_relaxed);
+        bucket.count.store(0, std::memory_order_relaxed);
+    }
+
+    if (bucket_id == id && (add || bucket.count.load(std::memory_order_relaxed))) {
+        bump_(bucket.count, add);
+        return;
+    }
+
+    // the element is older than its bucket
+    if (add) {
+        stale_oldest_.store(
+            std::min(stale_oldest_.load(std::memory_order_relaxed), id),
+            std::memory_order_relaxed
+        );
+    }
+    if (add || stale_count_.load(std::memory_order_relaxed)) {
+        bump_(stale_count_, add);
+    }
+    if (stale_count_.load(std::memory_order_relaxed) == 0) {
+        stale_oldest_.store(NO_BUCKET, std::memory_order_relaxed);
+    }
+}
+
+template <class T>
+PendingSnapshot PendingMonitor<T>::snapshot(size_t top_n) const
+{
+    PendingSnapshot result{};
+    std::vector<std::pair<uint64_t, size_t>> keys;
+    int64_t oldest = NO_BUCKET;
+
+    for (size_t attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+        uint64_t sequence = sequence_.load(std::memory_order_acquire);
+        if (sequence & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+
+        result.pending = pending_.load(std::memory_order_relaxed);
+        result.per_class.clear();
+        for (const auto& count : per_class_) {
+            result.per_class.push_back(count.load(std::memory_order_relaxed));
+        }
+
+        oldest = NO_BUCKET;
+        if (stale_count_.load(std::memory_order_relaxed)) {
+            oldest = stale_oldest_.load(std::memory_order_relaxed);
+        }
+        for (const auto& bucket : buckets_) {
+            if (bucket.count.load(std::memory_order_relaxed)) {
+                oldest = std::min(oldest, bucket.id.load(std::memory_order_relaxed));
+            }
+        }
+
+        keys.clear();
+        for (const auto& slot : keys_) {
+            size_t count = slot.count.load(std::memory_order_relaxed);
+            if (count) {
+                keys.emplace_back(slot.key.load(std::memory_order_relaxed), count);
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        result.consistent = sequence_.load(std::memory_order_relaxed) == sequence;
+        if (result.consistent) {
+            break;
+        }
+    }
+
+    if (oldest != NO_BUCKET) {
+        auto age = clock::now() - (origin_ + granularity_ * oldest);
+        result.oldest_age = std::chrono::duration_cast<std::chrono::milliseconds>(age);
+    }
+
+    top_n = std::min(top_n, keys.size());
+    std::partial_sort(keys.begin(), keys.begin() + top_n, keys.end(), [](auto& a, auto& b) {
+        return a.second > b.second;
+    });
+    keys.resize(top_n);
+    result.top_keys = std::move(keys);
+    return result;
+}
+
+template <class T>
+MonitoredScheduler<T>::MonitoredScheduler(
+    std::unique_ptr<Scheduler<T>> scheduler,
+    PendingMonitor<T>& monitor
+)
+    : scheduler_(std::move(scheduler)),
+      monitor_(monitor)
+{ }
+
+template <class T>
+void MonitoredScheduler<T>::push(T&& x)
+{
+    monitor_.add(x);
+    scheduler_->push(std::move(x));
+}
+
+template <class T>
+std::optional<T> MonitoredScheduler<T>::take(size_t& lane)
+{
+    std::optional<T> x = scheduler_->take(lane);
+    if (x) {
+        monitor_.remove(*x);
+    }
+    return x;
+}
+
+template <class T>
+void MonitoredScheduler<T>::done(size_t lane)
+{ scheduler_->done(lane); }
+
+template <class T>
+std::optional<T> MonitoredScheduler<T>::take_any()
+{
+    std::optional<T> x = scheduler_->take_any();
+    if (x) {
+        monitor_.remove(*x);
+    }
+    return x;
+}
+
+template <class T>
+bool MonitoredScheduler<T>::ready() const
+{ return scheduler_->ready(); }
+
+template <class T>
+size_t MonitoredScheduler<T>::size() const
+{ return scheduler_->size(); }
+
+template <class T>
+bool MonitoredScheduler<T>::empty() const
+{ return scheduler_->empty(); }
+
+}
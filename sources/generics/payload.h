@@ -0,0 +1,271 @@
+#pragma once
+
+#include <new>
+
+#include "gendef.h"
+#include "slab.h"
+
+// Declarations
+namespace gen
+{
+
+/// 8-byte reference to a payload in a PayloadStore: the slot index
+/// and the generation of the slot when the payload was stored, so a
+/// handle to a released payload is recognised instead of aliasing
+/// the slot's next payload
+struct PayloadHandle
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const PayloadHandle&) const = default;
+};
+
+static_assert(sizeof(PayloadHandle) == 8);
+
+template <class T>
+class PayloadStore;
+
+/// What a handler sees of a payload, valid until the payload is released
+template <class T>
+class PayloadView
+{
+ public:
+    PayloadView(PayloadStore<T>& store, PayloadHandle handle) noexcept;
+
+    T& operator*() const noexcept;
+    T* operator->() const noexcept;
+
+    PayloadHandle handle() const noexcept;
+
+ private:
+    PayloadStore<T>* store_;
+    PayloadHandle    handle_;
+};
+
+/// Payloads live in slab slots and are passed around by handle, so
+/// queues move 8 bytes per element whatever the payload size. A slot
+/// keeps its object when released and the next put_with() can refill
+/// it in place, e.g. reusing a string's buffer without malloc
+template <class T>
+class PayloadStore
+{
+ public:
+    explicit PayloadStore(size_t max_size = (size_t(1) << 24));
+
+    /// Handles fail valid() if max_size payloads are held
+    PayloadHandle put(T&& value);
+
+    /// fill(T&) writes the payload into a recycled object
+    template <class F>
+    PayloadHandle put_with(F&& fill);
+
+    /// Recycles the slot and invalidates every handle to it,
+    /// releasing an invalid handle does nothing
+    void release(PayloadHandle handle) noexcept;
+
+    bool valid(PayloadHandle handle) const noexcept;
+
+    /// handle must be valid
+    T&             get(PayloadHandle handle) noexcept;
+    PayloadView<T> view(PayloadHandle handle) noexcept;
+
+    /// Number of payloads held
+    size_t size() const noexcept;
+
+ private:
+    struct Slot
+    {
+        T                     value;
+        std::atomic<uint32_t> generation{0};
+    };
+
+    Slab<Slot>          slots_;
+    std::atomic<size_t> size_;
+};
+
+/// Resource which can also write its next element into an existing object
+template <class R, class T>
+concept FillingResource = requires(R& r, T& slot)
+{
+    r.get_data(slot);
+};
+
+/// Resource adapter storing the payloads of res in a PayloadStore and
+/// handing their handles to the manager. If res has get_data(T&), the
+/// payload is written into a recycled slot through put_with()
+template <ResourceLike Res>
+class PayloadResource
+{
+ public:
+    using payload_t = resource_data_t<Res>;
+
+    PayloadResource(Res& resource, PayloadStore<payload_t>& store);
+
+    PayloadHandle get_data();
+    bool          is_empty();
+
+ private:
+    Res&                     resource_;
+    PayloadStore<payload_t>& store_;
+};
+
+/// Handler adapter calling h.process(PayloadView<T>) and releasing the
+/// payload afterwards, unless the handler gives it back by throwing
+/// OperationCancelled and the manager keeps the handle
+template <class T, class H>
+class PayloadHandler
+{
+ public:
+    PayloadHandler(H& handler, PayloadStore<T>& store);
+
+    auto process(PayloadHandle&& handle);
+
+ private:
+    H&               handler_;
+    PayloadStore<T>& store_;
+};
+
+}
+
+// Definitions
+namespace gen
+{
+
+template <class T>
+PayloadView<T>::PayloadView(PayloadStore<T>& store, PayloadHandle handle) noexcept
+    : store_(&store),
+      handle_(handle)
+{ }
+
+template <class T>
+T& PayloadView<T>::operator*() const noexcept
+{ return store_->get(handle_); }
+
+template <class T>
+T* PayloadView<T>::operator->() const noexcept
+{ return &store_->get(handle_); }
+
+template <class T>
+PayloadHandle PayloadView<T>::handle() const noexcept
+{ return handle_; }
+
+template <class T>
+PayloadStore<T>::PayloadStore(size_t max_size)
+    : slots_(max_size),
+      size_(0)
+{ }
+
+template <class T>
+PayloadHandle PayloadStore<T>::put(T&& value)
+{ return put_with([&](T& slot) { slot = std::move(value); }); }
+
+template <class T>
+template <class F>
+PayloadHandle PayloadStore<T>::put_with(F&& fill)
+{
+    uint32_t index = slots_.acquire();
+    if (index == Slab<Slot>::NONE) {
+        return PayloadHandle();
+    }
+
+    Slot& slot = slots_[index];
+    try {
+        fill(slot.value);
+    } catch (...) {
+        slots_.release(index);
+        throw;
+    }
+    size_.fetch_add(1, std::memory_order_relaxed);
+    return PayloadHandle{index, slot.generation.load(std::memory_order_relaxed)};
+}
+
+template <class T>
+void PayloadStore<T>::release(PayloadHandle handle) noexcept
+{
+    if (handle.index >= slots_.capacity()) {
+        return;
+    }
+    // only one of concurrent releases of a handle recycles the slot
+    uint32_t generation = handle.generation;
+    if (!slots_[handle.index].generation.compare_exchange_strong(
+            generation, generation + 1, std::memory_order_acq_rel)) {
+        return;
+    }
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    slots_.release(handle.index);
+}
+
+template <class T>
+bool PayloadStore<T>::valid(PayloadHandle handle) const noexcept
+{
+    return handle.index < slots_.capacity()
+        && slots_[handle.index].generation.load(std::memory_order_relaxed) == handle.generation;
+}
+
+template <class T>
+T& PayloadStore<T>::get(PayloadHandle handle) noexcept
+{ return slots_[handle.index].value; }
+
+template <class T>
+PayloadView<T> PayloadStore<T>::view(PayloadHandle handle) noexcept
+{ return PayloadView<T>(*this, handle); }
+
+template <class T>
+size_t PayloadStore<T>::size() const noexcept
+{ return size_.load(std::memory_order_relaxed); }
+
+template <ResourceLike Res>
+PayloadResource<Res>::PayloadResource(Res& resource, PayloadStore<payload_t>& store)
+    : resource_(resource),
+      store_(store)
+{ }
+
+template <ResourceLike Res>
+PayloadHandle PayloadResource<Res>::get_data()
+{
+    PayloadHandle handle;
+    if constexpr (FillingResource<Res, payload_t>) {
+        handle = store_.put_with([&](payload_t& slot) { resource_.get_data(slot); });
+    } else {
+        handle = store_.put(resource_.get_data());
+    }
+    if (!store_.valid(handle)) {
+        throw std::bad_alloc();
+    }
+    return handle;
+}
+
+template <ResourceLike Res>
+bool PayloadResource<Res>::is_empty()
+{ return resource_.is_empty(); }
+
+template <class T, class H>
+PayloadHandler<T, H>::PayloadHandler(H& handler, PayloadStore<T>& store)
+    : handler_(handler),
+      store_(store)
+{ }
+
+template <class T, class H>
+auto PayloadHandler<T, H>::process(PayloadHandle&& handle)
+{
+    using result_t = decltype(handler_.process(store_.view(handle)));
+
+    try {
+        if constexpr (std::is_void_v<result_t>) {
+            handler_.process(store_.view(handle));
+            store_.release(handle);
+        } else {
+            result_t result = handler_.process(store_.view(handle));
+            store_.release(handle);
+            return result;
+        }
+    } catch (const OperationCancelled&) {
+        throw;
+    } catch (...) {
+        store_.release(handle);
+        throw;
+    }
+}
+
+}
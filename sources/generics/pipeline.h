@@ -0,0 +1,445 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "queue.h"
+#include "stats.h"
+#include "gendef.h"
+#include "channel.h"
+#include "manager.h"
+#include "handler.h"
+#include "resource.h"
+
+// Declarations
+namespace gen
+{
+
+struct StageStats
+{
+    std::string  name;
+    ManagerStats manager;
+    size_t       input_depth;     // elements waiting in the inbound channel
+    uint64_t     blocked_pushes;  // upstream waits on the inbound channel
+    size_t       backup_size;
+};
+
+class PipelineStage
+{
+ public:
+    virtual ~PipelineStage() = default;
+
+    virtual void start() = 0;
+    virtual void stop() = 0;
+    virtual void stop(StopMode mode, std::chrono::milliseconds timeout,
+                      std::chrono::milliseconds grace) = 0;
+
+    virtual void save_session_data() = 0;
+    virtual void restore_session_data() = 0;
+
+    virtual StageStats stats() const = 0;
+};
+
+/// Feeds results of an intermediate stage into the next stage's channel
+template <class In, class Out>
+class StageAdapter final : public DataHandler<In>
+{
+ public:
+    StageAdapter(DataHandler<In, Out>& handler, size_t channel_size);
+
+    void process(In&& data) override;
+
+    Channel<Out>& output() noexcept;
+
+ private:
+    DataHandler<In, Out>& handler_;
+    Channel<Out>          output_;
+};
+
+/// Stage is a manager over concrete resource and handler types,
+/// so channel and adapter calls are dispatched statically
+template <class Res, class H>
+class StageImpl final : public PipelineStage
+{
+ public:
+    using data_t = resource_data_t<Res>;
+
+    StageImpl
+        (
+            std::string name,
+            Res& input,
+            Channel<data_t>* input_channel,
+            std::unique_ptr<H> adapter,
+            H& handler,
+            size_t max_queue_size,
+            size_t n_of_threads
+        );
+
+    void start() override;
+    void stop() override;
+    void stop(StopMode mode, std::chrono::milliseconds timeout,
+              std::chrono::milliseconds grace) override;
+
+    void save_session_data() override;
+    void restore_session_data() override;
+
+    StageStats stats() const override;
+
+ private:
+    std::string      name_;
+    Channel<data_t>* input_channel_;
+
+    // outlives manager_, which may save to it until destroyed
+    Queue<data_t> backup_;
+
+    std::unique_ptr<H>           adapter_;
+    BasicResourceManager<Res, H> manager_;
+};
+
+class Pipeline;
+
+template <class T>
+class PipelineBuilder
+{
+ public:
+    explicit PipelineBuilder(Resource<T>& source);
+
+    /// Appends an intermediate stage; its results are passed
+    /// downstream through a channel of max_queue_size elements
+    template <class Out>
+    PipelineBuilder<Out> then
+        (
+            std::string name,
+            DataHandler<T, Out>& handler,
+            size_t max_queue_size,
+            size_t n_of_threads
+        );
+
+    /// Appends the final stage and returns the assembled pipeline
+    Pipeline finish
+        (
+            std::string name,
+            DataHandler<T>& sink,
+            size_t max_queue_size,
+            size_t n_of_threads
+        );
+
+ private:
+    template <class U>
+    friend class PipelineBuilder;
+
+    using stages_t = std::vector<std::unique_ptr<PipelineStage>>;
+
+    PipelineBuilder(Channel<T>& channel, stages_t&& stages);
+
+    template <class H>
+    void append_(std::string name, std::unique_ptr<H> adapter, H& handler,
+                 size_t max_queue_size, size_t n_of_threads);
+
+    Resource<T>* source_;
+    Channel<T>*  input_channel_;
+    stages_t     stages_;
+};
+
+/// Chain of ResourceManagers connected with bounded channels.
+/// Every stage has its own thread budget; a full channel blocks
+/// the upstream workers, so backpressure reaches the source.
+class Pipeline
+{
+ public:
+    Pipeline(Pipeline&&) noexcept = default;
+    ~Pipeline();
+
+    Pipeline() = delete;
+    Pipeline(const Pipeline&) = delete;
+
+    template <class T>
+    static PipelineBuilder<T> from(Resource<T>& source);
+
+    void start();
+
+    /// Stops stages from the source to the sink, so that
+    /// blocked upstream workers are drained by running stages
+    void stop();
+
+    /// Bounded stop of every stage, see BasicResourceManager::stop;
+    /// in draining modes a stage first waits for its inbound channel
+    /// to be emptied, timeout is shared by all stages
+    void stop(
+        StopMode mode,
+        std::chrono::milliseconds timeout = std::chrono::milliseconds(0),
+        std::chrono::milliseconds grace = std::chrono::milliseconds(50)
+    );
+
+    /// Stops the pipeline and keeps waiting data of every stage
+    /// (its queue and its inbound channel) in the stage backup
+    void save_session_data();
+    void restore_session_data();
+
+    size_t backup_size() const;
+
+    std::vector<StageStats> stats() const;
+
+ private:
+    template <class T>
+    friend class PipelineBuilder;
+
+    explicit Pipeline(std::vector<std::unique_ptr<PipelineStage>>&& stages);
+
+    std::vector<std::unique_ptr<PipelineStage>> stages_;
+    Status current_state_;
+};
+
+}
+
+// Definitions
+namespace gen
+{
+
+template <class In, class Out>
+StageAdapter<In, Out>::StageAdapter(
+    DataHandler<In, Out>& handler,
+    size_t channel_size
+)
+    : handler_(handler),
+      output_(channel_size)
+{ }
+
+template <class In, class Out>
+void StageAdapter<In, Out>::process(In&& data)
+{ output_.push(handler_.process(std::move(data))); }
+
+template <class In, class Out>
+Channel<Out>& StageAdapter<In, Out>::output() noexcept
+{ return output_; }
+
+template <class Res, class H>
+StageImpl<Res, H>::StageImpl(
+    std::string name,
+    Res& input,
+    Channel<data_t>* input_channel,
+    std::unique_ptr<H> adapter,
+    H& handler,
+    size_t max_queue_size,
+    size_t n_of_threads
+)
+    : name_(std::move(name)),
+      input_channel_(input_channel),
+      backup_(max_queue_size + (input_channel ? input_channel->max_size() : 0)),
+      adapter_(std::move(adapter)),
+      manager_(input, handler, max_queue_size, n_of_threads)
+{ }
+
+template <class Res, class H>
+void StageImpl<Res, H>::start()
+{ manager_.start(); }
+
+template <class Res, class H>
+void StageImpl<Res, H>::stop()
+{ manager_.stop(); }
+
+template <class Res, class H>
+void StageImpl<Res, H>::stop(
+    StopMode mode,
+    std::chrono::milliseconds timeout,
+    std::chrono::milliseconds grace
+)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto deadline = clock::now() + timeout;
+    if (mode != STOP_IMMEDIATE && input_channel_) {
+        while (!input_channel_->is_empty()
+               && (mode == STOP_DRAIN || clock::now() < deadline)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+    manager_.stop(mode, std::max(left, std::chrono::milliseconds(0)), grace);
+}
+
+template <class Res, class H>
+void StageImpl<Res, H>::save_session_data()
+{
+    manager_.save_session_data(backup_);
+    if (input_channel_) {
+        input_channel_->move_to(backup_);
+    }
+}
+
+template <class Res, class H>
+void StageImpl<Res, H>::restore_session_data()
+{ manager_.restore_session_data(backup_); }
+
+template <class Res, class H>
+StageStats StageImpl<Res, H>::stats() const
+{
+    return StageStats{
+        name_,
+        manager_.stats(),
+        input_channel_ ? input_channel_->size() : 0,
+        input_channel_ ? input_channel_->blocked_pushes() : 0,
+        backup_.size()
+    };
+}
+
+template <class T>
+PipelineBuilder<T>::PipelineBuilder(Resource<T>& source)
+    : source_(&source),
+      input_channel_(nullptr)
+{ }
+
+template <class T>
+PipelineBuilder<T>::PipelineBuilder(Channel<T>& channel, stages_t&& stages)
+    : source_(nullptr),
+      input_channel_(&channel),
+      stages_(std::move(stages))
+{ }
+
+template <class T>
+template <class H>
+void PipelineBuilder<T>::append_(
+    std::string name,
+    std::unique_ptr<H> adapter,
+    H& handler,
+    size_t max_queue_size,
+    size_t n_of_threads
+)
+{
+    if (source_) {
+        stages_.push_back(std::make_unique<StageImpl<Resource<T>, H>>(
+            std::move(name), *source_, nullptr, std::move(adapter),
+            handler, max_queue_size, n_of_threads
+        ));
+    } else {
+        stages_.push_back(std::make_unique<StageImpl<Channel<T>, H>>(
+            std::move(name), *input_channel_, input_channel_, std::move(adapter),
+            handler, max_queue_size, n_of_threads
+        ));
+    }
+}
+
+template <class T>
+template <class Out>
+PipelineBuilder<Out> PipelineBuilder<T>::then(
+    std::string name,
+    DataHandler<T, Out>& handler,
+    size_t max_queue_size,
+    size_t n_of_threads
+)
+{
+    auto adapter = std::make_unique<StageAdapter<T, Out>>(handler, max_queue_size);
+    StageAdapter<T, Out>& stage_handler = *adapter;
+
+    append_(std::move(name), std::move(adapter), stage_handler,
+            max_queue_size, n_of_threads);
+
+    return PipelineBuilder<Out>(stage_handler.output(), std::move(stages_));
+}
+
+template <class T>
+Pipeline PipelineBuilder<T>::finish(
+    std::string name,
+    DataHandler<T>& sink,
+    size_t max_queue_size,
+    size_t n_of_threads
+)
+{
+    append_(std::move(name), std::unique_ptr<DataHandler<T>>(), sink,
+            max_queue_size, n_of_threads);
+
+    return Pipeline(std::move(stages_));
+}
+
+template <class T>
+PipelineBuilder<T> Pipeline::from(Resource<T>& source)
+{ return PipelineBuilder<T>(source); }
+
+inline Pipeline::Pipeline(std::vector<std::unique_ptr<PipelineStage>>&& stages)
+    : stages_(std::move(stages)),
+      current_state_(STATUS_STOPPED)
+{ }
+
+inline Pipeline::~Pipeline()
+{
+    stop();
+    while (!stages_.empty()) {
+        stages_.pop_back();
+    }
+}
+
+inline void Pipeline::start()
+{
+    current_state_ = STATUS_RUNNING;
+    for (auto it = stages_.rbegin(); it != stages_.rend(); ++it) {
+        (*it)->start();
+    }
+}
+
+inline void Pipeline::stop()
+{
+    for (auto& stage : stages_) {
+        stage->stop();
+    }
+    current_state_ = STATUS_STOPPED;
+}
+
+inline void Pipeline::stop(
+    StopMode mode,
+    std::chrono::milliseconds timeout,
+    std::chrono::milliseconds grace
+)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto deadline = clock::now() + timeout;
+    for (auto& stage : stages_) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock::now());
+        stage->stop(mode, std::max(left, std::chrono::milliseconds(0)), grace);
+    }
+    current_state_ = STATUS_STOPPED;
+}
+
+inline void Pipeline::save_session_data()
+{
+    if (current_state_ == STATUS_RUNNING) {
+        stop();
+    }
+    for (auto& stage : stages_) {
+        stage->save_session_data();
+    }
+}
+
+inline void Pipeline::restore_session_data()
+{
+    if (current_state_ == STATUS_RUNNING) {
+        stop();
+    }
+    for (auto& stage : stages_) {
+        stage->restore_session_data();
+    }
+}
+
+inline size_t Pipeline::backup_size() const
+{
+    size_t total = 0;
+    for (auto& stage : stages_) {
+        total += stage->stats().backup_size;
+    }
+    return total;
+}
+
+inline std::vector<StageStats> Pipeline::stats() const
+{
+    std::vector<StageStats> result;
+    result.reserve(stages_.size());
+    for (auto& stage : stages_) {
+        result.push_back(stage->stats());
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,247 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "gendef.h"
+#include "queue.h"
+
+namespace gen
+{
+
+struct ProducerPolicy
+{
+    size_t                    max_items = 64;  // push() flushes a buffer this full
+    std::chrono::microseconds max_age = std::chrono::microseconds(1000);  // the flusher thread one this old
+};
+
+/// Accumulates pushed elements in per-thread buffers and hands a whole
+/// buffer to the sink in one call once it holds max_items elements or
+/// its oldest element is max_age old. Elements pushed by one thread
+/// reach the sink in order
+template <class T>
+class BufferedProducer
+{
+ public:
+    /// Takes the elements of one flush, the vector is cleared afterwards
+    using sink_t = std::function<void(std::vector<T>&)>;
+
+    explicit BufferedProducer(sink_t sink, ProducerPolicy policy = ProducerPolicy());
+
+    /// Flushes into queue with Queue::push_all()
+    explicit BufferedProducer(Queue<T>& queue, ProducerPolicy policy = ProducerPolicy());
+
+    BufferedProducer(const BufferedProducer&) = delete;
+
+    /// Stops the flusher thread and flushes all buffers
+    ~BufferedProducer();
+
+    void push(T value);
+
+    /// Hands the elements buffered by all threads to the sink
+    void flush();
+
+    const ProducerPolicy& policy() const;
+
+    size_t flushes() const;  // sink calls
+    size_t pushed() const;
+
+ private:
+    struct Buffer
+    {
+        mutex_t        flush_mutex;  // orders flushes of the buffer
+        mutex_t        mutex;        // guards items and since
+        std::vector<T> items;
+        std::vector<T> flushing;     // handed to the sink under flush_mutex only
+        std::chrono::steady_clock::time_point since;  // when items.front() was pushed
+    };
+
+    sink_t         sink_;
+    ProducerPolicy policy_;
+    const uint64_t id_;
+
+    mutable mutex_t                      buffers_mutex_;
+    std::vector<std::unique_ptr<Buffer>> buffers_;
+
+    std::atomic<size_t> flushes_;
+    std::atomic<size_t> pushed_;
+
+    mutex_t    stop_mutex_;
+    cond_var_t cv_stop_;
+    bool       stopping_;
+    thread_t   flusher_;
+
+    static std::atomic<uint64_t>& next_id_();
+
+    Buffer& buffer_();
+    void flush_(Buffer& buffer);
+    void flush_stale_();
+    std::vector<Buffer*> buffers_snapshot_() const;
+};
+
+template <class T>
+BufferedProducer<T>::BufferedProducer(sink_t sink, ProducerPolicy policy)
+    : sink_(std::move(sink)),
+      policy_(policy),
+      id_(next_id_()++),
+      flushes_(0),
+      pushed_(0),
+      stopping_(false)
+{
+    name_lock(buffers_mutex_, "producer.buffers");
+    flusher_ = thread_t([this] { flush_stale_(); });
+}
+
+template <class T>
+BufferedProducer<T>::BufferedProducer(Queue<T>& queue, ProducerPolicy policy)
+    : BufferedProducer([&queue](std::vector<T>& items) { queue.push_all(items); }, policy)
+{ }
+
+template <class T>
+BufferedProducer<T>::~BufferedProducer()
+{
+    {
+        lock_t lock(stop_mutex_);
+        stopping_ = true;
+    }
+    cv_stop_.notify_all();
+    flusher_.join();
+
+    flush();
+}
+
+template <class T>
+void BufferedProducer<T>::push(T value)
+{
+    Buffer& buffer = buffer_();
+    pushed_.fetch_add(1, std::memory_order_relaxed);
+
+    lock_t lock(buffer.mutex);
+    if (buffer.items.empty()) {
+        buffer.since = std::chrono::steady_clock::now();
+    }
+    buffer.items.push_back(std::move(value));
+    bool full = buffer.items.size() >= policy_.max_items;
+    lock.unlock();
+
+    if (full) {
+        flush_(buffer);
+    }
+}
+
+template <class T>
+void BufferedProducer<T>::flush()
+{
+    for (Buffer* buffer : buffers_snapshot_()) {
+        flush_(*buffer);
+    }
+}
+
+template <class T>
+const ProducerPolicy& BufferedProducer<T>::policy() const
+{ return policy_; }
+
+template <class T>
+size_t BufferedProducer<T>::flushes() const
+{ return flushes_.load(std::memory_order_relaxed); }
+
+template <class T>
+size_t BufferedProducer<T>::pushed() const
+{ return pushed_.load(std::memory_order_relaxed); }
+
+template <class T>
+std::atomic<uint64_t>& BufferedProducer<T>::next_id_()
+{
+    static std::atomic<uint64_t> id(1);
+    return id;
+}
+
+template <class T>
+typename BufferedProducer<T>::Buffer& BufferedProducer<T>::buffer_()
+{
+    struct Cached
+    {
+        uint64_t producer = 0;
+        Buffer*  buffer = nullptr;
+    };
+    thread_local Cached cached;
+    thread_local std::vector<std::pair<uint64_t, Buffer*>> owned;
+
+    if (cached.producer == id_) {
+        return *cached.buffer;
+    }
+
+    Buffer* buffer = nullptr;
+    for (auto& [producer, b] : owned) {
+        if (producer == id_) {
+            buffer = b;
+        }
+    }
+    if (!buffer) {
+        lock_t lock(buffers_mutex_);
+        buffers_.push_back(std::make_unique<Buffer>());
+        buffer = buffers_.back().get();
+        buffer->items.reserve(policy_.max_items);
+        name_lock(buffer->mutex, "producer.buffer");
+        owned.emplace_back(id_, buffer);
+    }
+
+    cached = Cached{id_, buffer};
+    return *buffer;
+}
+
+template <class T>
+void BufferedProducer<T>::flush_(Buffer& buffer)
+{
+    lock_t flush_lock(buffer.flush_mutex);
+    {
+        lock_t lock(buffer.mutex);
+        if (buffer.items.empty()) {
+            return;
+        }
+        buffer.items.swap(buffer.flushing);
+    }
+
+    // the sink may block, pushes to the other vector go on meanwhile
+    sink_(buffer.flushing);
+    buffer.flushing.clear();
+    flushes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class T>
+void BufferedProducer<T>::flush_stale_()
+{
+    using clock = std::chrono::steady_clock;
+
+    // checking twice per max_age keeps elements at most 1.5 max_age waiting
+    auto interval = std::max(policy_.max_age / 2, std::chrono::microseconds(1));
+    lock_t lock(stop_mutex_);
+    while (!cv_stop_.wait_for(lock, interval, [&] { return stopping_; })) {
+        lock.unlock();
+        for (Buffer* buffer : buffers_snapshot_()) {
+            bool stale;
+            {
+                lock_t buffer_lock(buffer->mutex);
+                stale = !buffer->items.empty() && clock::now() - buffer->since >= policy_.max_age;
+            }
+            if (stale) {
+                flush_(*buffer);
+            }
+        }
+        lock.lock();
+    }
+}
+
+template <class T>
+std::vector<typename BufferedProducer<T>::Buffer*> BufferedProducer<T>::buffers_snapshot_() const
+{
+    lock_t lock(buffers_mutex_);
+    std::vector<Buffer*> snapshot;
+    snapshot.reserve(buffers_.size());
+    for (auto& buffer : buffers_) {
+        snapshot.push_back(buffer.get());
+    }
+    return snapshot;
+}
+}
@@ -2,8 +2,10 @@
 
 #include "gendef.h"
 
+#include <algorithm>
 #include <iterator>
 #include <mutex>
+#include <vector>
 
 // Declarations
 namespace gen
@@ -81,10 +83,17 @@ class Queue
     size_t size() const noexcept;
     size_t max_size() const noexcept;
 
+    /// May reallocate the ring, references from front() and back()
+    /// do not survive it
     void pop() noexcept;
 
     void clear() noexcept;
 
+    /// Reallocates the ring to the smallest capacity holding the elements;
+    /// pop() also halves the ring once it is a quarter full, but never
+    /// below the initial capacity
+    void shrink_to_fit() noexcept;
+
     value_t take_first() noexcept;
 
     void push(const value_t& x);
@@ -93,6 +102,10 @@ class Queue
     template <class...Args>
     void emplace(Args&& ...args) noexcept;
 
+    /// Moves all items to the back under one lock, growing the ring
+    /// at most once; leaves items empty
+    void push_all(std::vector<value_t>& items) noexcept;
+
     void move_to(Queue<T>& other) noexcept;
 
     void swap(Queue<T>& other) noexcept;
@@ -109,13 +122,19 @@ class Queue
     size_t front_;
     size_t back_;
 
-    mutable std::mutex access_mutex_;
+    // pop() does not shrink the ring below this capacity
+    size_t min_capacity_;
+
+    mutable mutex_t access_mutex_;
 
     static constexpr size_t MIN_CAP = 8;
     static allocator_t& Get_Allocator();
 
     template <class Q = Queue<T>>
     void emplace_tail_(Q&& q) noexcept;
+
+    void pop_() noexcept;
+    void relocate_(size_t new_capacity) noexcept;
 };
 }
 
@@ -210,8 +229,9 @@ Queue<T, Alloc>::Queue()
     size_(0),
     capacity_(0),
     front_(0),
-    back_(0)
-{ }
+    back_(0),
+    min_capacity_(MIN_CAP)
+{ name_lock(access_mutex_, "queue"); }
 
 template <class T, class Alloc>
 Queue<T, Alloc>::~Queue()
@@ -232,6 +252,7 @@ Queue<T, Alloc>::Queue(size_t init_capacity)
         }
         capacity_  = cap;
         data_      = alloc_traits::allocate(Get_Allocator(), capacity_);
+        min_capacity_ = std::max(cap, MIN_CAP);
     }
 }
 
@@ -261,12 +282,16 @@ Queue<T, Alloc>::Queue(const Queue& src)
         data_     = alloc_traits::allocate(Get_Allocator(), src.capacity_);
         capacity_ = src.capacity_;
         size_     = src.size_;
-        back_     = src.back_;
-        front_    = src.front_;
+        back_     = src.size_ & (src.capacity_ - 1);
+        front_    = 0;
     }
+    min_capacity_ = src.min_capacity_;
 
-    for (size_t i = 0; i < src.size_; ++i)
-        alloc_traits::construct(Get_Allocator(), data_ + i, src.data_[i]);
+    // the copy is unwrapped, elements start at the beginning of the ring
+    for (size_t i = 0; i < src.size_; ++i) {
+        size_t it = (src.front_ + i) & (src.capacity_ - 1);
+        alloc_traits::construct(Get_Allocator(), data_ + i, src.data_[it]);
+    }
 }
 
 template <class T, class Alloc>
@@ -315,20 +340,23 @@ T& Queue<T, Alloc>::back() noexcept
 template <class T, class Alloc>
 bool Queue<T, Alloc>::full() const noexcept
 {
-    std::lock_guard<std::mutex> guard(access_mutex_);
+    std::lock_guard<mutex_t> guard(access_mutex_);
     return size_ == capacity_;
 }
 
 template <class T, class Alloc>
 bool Queue<T, Alloc>::empty() const noexcept
 {
-    std::lock_guard<std::mutex> guard(access_mutex_);
+    std::lock_guard<mutex_t> guard(access_mutex_);
     return (size_ == 0);
 }
 
 template <class T, class Alloc>
 size_t Queue<T, Alloc>::size() const noexcept
-{ return size_; }
+{
+    std::lock_guard<mutex_t> guard(access_mutex_);
+    return size_;
+}
 
 template <class T, class Alloc>
 size_t Queue<T, Alloc>::max_size() const noexcept
@@ -337,20 +365,75 @@ size_t Queue<T, Alloc>::max_size() const noexcept
 template <class T, class Alloc>
 void Queue<T, Alloc>::pop() noexcept
 {
+    std::lock_guard<mutex_t> guard(access_mutex_);
+    pop_();
+}
+
+template <class T, class Alloc>
+void Queue<T, Alloc>::pop_() noexcept
+{
+    // called with access_mutex_ held
     if (size_) {
         alloc_traits::destroy(Get_Allocator(), data_ + front_);
         front_ = (front_ + 1) & (capacity_ - 1);
 
         if (--size_ == 0)
             front_ = back_ = 0;
+
+        // halving at a quarter leaves the ring half full,
+        // so pushes and pops around one size do not reallocate
+        if (capacity_ > min_capacity_ && size_ <= capacity_ / 4)
+            relocate_(capacity_ / 2);
+    }
+}
+
+template <class T, class Alloc>
+void Queue<T, Alloc>::shrink_to_fit() noexcept
+{
+    std::lock_guard<mutex_t> guard(access_mutex_);
+
+    size_t cap = MIN_CAP;
+    while (cap < size_) {
+        cap <<= 1;
+    }
+    if (cap < capacity_) {
+        relocate_(cap);
+    }
+}
+
+template <class T, class Alloc>
+void Queue<T, Alloc>::relocate_(size_t new_capacity) noexcept
+{
+    try {
+        T* new_ring = alloc_traits::allocate(Get_Allocator(), new_capacity);
+        for (size_t it = 0; it < size_; ++it) {
+            alloc_traits::construct(
+                Get_Allocator(),
+                new_ring + it,
+                std::move_if_noexcept(data_[front_])
+            );
+            alloc_traits::destroy(Get_Allocator(), data_ + front_);
+            front_ = (front_ + 1) & (capacity_ - 1);
+        }
+        alloc_traits::deallocate(Get_Allocator(), data_, capacity_);
+
+        data_ = new_ring;
+        capacity_ = new_capacity;
+        front_ = 0;
+        back_ = size_ & (capacity_ - 1);
+    } catch (std::bad_alloc& e) {
+#ifdef __INFO_DEBUG__
+        e.what();
+#endif  // __INFO_DEBUG__
     }
 }
 
 template <class T, class Alloc>
 void Queue<T, Alloc>::clear() noexcept
 {
+    std::lock_guard<mutex_t> guard(access_mutex_);
     while (size_)
-        pop();
+        pop_();
     size_  = 0;
     front_ = back_ = 0;
 }
@@ -365,10 +448,10 @@ T Queue<T, Alloc>::take_first() noexcept
     }
 #endif  // __INFO_DEBUG__
 
-    std::lock_guard<std::mutex> guard(access_mutex_);
+    std::lock_guard<mutex_t> guard(access_mutex_);
 
-    value_t value = front();
-    pop();
+    value_t value = std::move(front());
+    pop_();
     return value;
 }
 
@@ -384,7 +467,7 @@ template <class T, class Alloc>
 template <class...Args>
 void Queue<T, Alloc>::emplace(Args&& ...args) noexcept
 {
-    std::lock_guard<std::mutex> guard(access_mutex_);
+    std::lock_guard<mutex_t> guard(access_mutex_);
     if (size_ == capacity_) {
         size_t new_capacity = capacity_ ? (capacity_ * 2) : MIN_CAP;
         try {
@@ -399,10 +482,12 @@ void Queue<T, Alloc>::emplace(Args&& ...args) noexcept
                     new_ring + it,
                     std::move_if_noexcept(data_[front_])
                 );
+                alloc_traits::destroy(Get_Allocator(), data_ + front_);
                 front_ = (front_ + 1) & (capacity_ - 1);
             }
             alloc_traits::deallocate(Get_Allocator(), data_, capacity_);
 
+            front_ = 0;
             back_ = ++size_;
             capacity_ = new_capacity;
             data_ = new_ring;
@@ -421,6 +506,29 @@ void Queue<T, Alloc>::emplace(Args&& ...args) noexcept
     ++size_;
 }
 
+template <class T, class Alloc>
+void Queue<T, Alloc>::push_all(std::vector<value_t>& items) noexcept
+{
+    std::lock_guard<mutex_t> guard(access_mutex_);
+    size_t new_capacity = capacity_ ? capacity_ : MIN_CAP;
+    while (new_capacity < size_ + items.size()) {
+        new_capacity *= 2;
+    }
+    if (new_capacity != capacity_) {
+        relocate_(new_capacity);
+    }
+
+    for (auto& x : items) {
+        if (size_ == capacity_) {
+            break;  // the ring could not grow
+        }
+        alloc_traits::construct(Get_Allocator(), data_ + back_, std::move(x));
+        back_ = (back_ + 1) & (capacity_ - 1);
+        ++size_;
+    }
+    items.clear();
+}
+
 template <class T, class Alloc>
 void Queue<T, Alloc>::move_to(Queue<T>& other) noexcept
 {
@@ -437,6 +545,7 @@ void Queue<T, Alloc>::swap(Queue<T>& other) noexcept
         std::swap(capacity_, other.capacity_);
         std::swap(front_, other.front_);
         std::swap(back_, other.back_);
+        std::swap(min_capacity_, other.min_capacity_);
     }
 }
 
@@ -467,11 +576,10 @@ template <class T, class Alloc>
 template <class Q>
 void Queue<T, Alloc>::emplace_tail_(Q&& q) noexcept
 {
-    size_t it = q.front_;
+    // q.pop() may shrink q's ring, so its front is read every time
     while (q.size_ && size_ < capacity_) {
-        emplace(std::move_if_noexcept(q.data_[it]));
+        emplace(std::move_if_noexcept(q.front()));
         q.pop();
-        it = (it + 1) & (q.capacity_ - 1);
     }
 }
 
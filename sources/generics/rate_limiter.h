@@ -0,0 +1,178 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+struct RateLimit
+{
+    double per_second;
+    size_t burst;
+};
+
+/// Lock-free token bucket: tokens are refilled at limit.per_second and
+/// at most limit.burst of them are accumulated. The state is a single
+/// theoretical arrival time (GCRA), so taking a token is one CAS
+class TokenBucket
+{
+ public:
+    using clock = std::chrono::steady_clock;
+
+    explicit TokenBucket(RateLimit limit);
+
+    TokenBucket(const TokenBucket&) = delete;
+
+    bool try_acquire(clock::time_point now = clock::now());
+
+    /// Takes a token in advance, returns when it may be used
+    clock::time_point reserve(clock::time_point now = clock::now());
+
+    /// Gives back a token taken by try_acquire() or reserve()
+    void refund();
+
+ private:
+    int64_t              interval_;   // nanoseconds per token
+    int64_t              tolerance_;  // nanoseconds of burst
+    std::atomic<int64_t> tat_;
+
+    static int64_t ticks_(clock::time_point t);
+};
+
+/// Global limit and per-class limits, where the class of an element is
+/// class_of(x); an element takes a token from both buckets which apply
+/// to it. Limits must be set before the limiter is used, acquiring
+/// tokens is lock-free and a limiter may be shared between managers
+template <class T>
+class RateLimiter
+{
+ public:
+    using clock = TokenBucket::clock;
+
+    RateLimiter() = default;
+
+    void limit_all(RateLimit limit);
+
+    template <class ClassOf>
+    void classify(ClassOf class_of);
+    void limit_class(size_t cls, RateLimit limit);
+
+    bool try_acquire(const T& x);
+    clock::time_point reserve(const T& x);
+
+ private:
+    std::unique_ptr<TokenBucket>              global_;
+    std::vector<std::unique_ptr<TokenBucket>> classes_;
+    std::function<size_t(const T&)>           class_of_;
+
+    TokenBucket* class_bucket_(const T& x);
+};
+
+inline TokenBucket::TokenBucket(RateLimit limit)
+    : interval_(static_cast<int64_t>(1e9 / limit.per_second)),
+      tolerance_(interval_ * static_cast<int64_t>(limit.burst ? limit.burst : 1)),
+      tat_(0)
+{ }
+
+inline int64_t TokenBucket::ticks_(clock::time_point t)
+{ return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count(); }
+
+inline bool TokenBucket::try_acquire(clock::time_point now)
+{
+    int64_t t = ticks_(now);
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+        next = std::max(tat, t) + interval_;
+        if (next - t > tolerance_) {
+            return false;
+        }
+    } while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+    return true;
+}
+
+inline TokenBucket::clock::time_point TokenBucket::reserve(clock::time_point now)
+{
+    int64_t t = ticks_(now);
+    int64_t tat = tat_.load(std::memory_order_relaxed);
+    int64_t next;
+    do {
+        next = std::max(tat, t) + interval_;
+    } while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+
+    return now + std::chrono::nanoseconds(std::max<int64_t>(0, next - t - tolerance_));
+}
+
+inline void TokenBucket::refund()
+{ tat_.fetch_sub(interval_, std::memory_order_relaxed); }
+
+template <class T>
+void RateLimiter<T>::limit_all(RateLimit limit)
+{ global_ = std::make_unique<TokenBucket>(limit); }
+
+template <class T>
+template <class ClassOf>
+void RateLimiter<T>::classify(ClassOf class_of)
+{
+    class_of_ = [class_of = std::move(class_of)](const T& x) mutable {
+        return static_cast<size_t>(class_of(x));
+    };
+}
+
+template <class T>
+void RateLimiter<T>::limit_class(size_t cls, RateLimit limit)
+{
+    if (classes_.size() <= cls) {
+        classes_.resize(cls + 1);
+    }
+    classes_[cls] = std::make_unique<TokenBucket>(limit);
+}
+
+template <class T>
+TokenBucket* RateLimiter<T>::class_bucket_(const T& x)
+{
+    if (!class_of_) {
+        return nullptr;
+    }
+    size_t cls = class_of_(x);
+    return cls < classes_.size() ? classes_[cls].get() : nullptr;
+}
+
+template <class T>
+bool RateLimiter<T>::try_acquire(const T& x)
+{
+    auto now = clock::now();
+    TokenBucket* bucket = class_bucket_(x);
+
+    if (bucket && !bucket->try_acquire(now)) {
+        return false;
+    }
+    if (global_ && !global_->try_acquire(now)) {
+        if (bucket) {
+            bucket->refund();
+        }
+        return false;
+    }
+    return true;
+}
+
+template <class T>
+typename RateLimiter<T>::clock::time_point RateLimiter<T>::reserve(const T& x)
+{
+    auto now = clock::now();
+    auto at = now;
+    if (TokenBucket* bucket = class_bucket_(x)) {
+        at = std::max(at, bucket->reserve(now));
+    }
+    if (global_) {
+        at = std::max(at, global_->reserve(now));
+    }
+    return at;
+}
+
+}
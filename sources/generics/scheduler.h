@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <vector>
+
+#include "queue.h"
+#include "gendef.h"
+
+namespace gen
+{
+
+/// Order in which a manager hands waiting elements to its workers.
+/// All methods are called with the manager's queue mutex held.
+template <class T>
+class Scheduler
+{
+ public:
+    static constexpr size_t NO_LANE = SIZE_MAX;
+
+    virtual ~Scheduler() = default;
+
+    virtual void push(T&& x) = 0;
+
+    /// Takes an element which may be processed right now; lane is
+    /// set to NO_LANE or to a lane which must be passed to done()
+    virtual std::optional<T> take(size_t& lane) = 0;
+    virtual void done(size_t lane) = 0;
+
+    /// Takes any waiting element in order, used to save the queue
+    virtual std::optional<T> take_any() = 0;
+
+    /// True if take() may succeed
+    virtual bool ready() const = 0;
+
+    /// Number of waiting elements (in flight ones are not counted)
+    virtual size_t size() const = 0;
+    virtual bool empty() const = 0;
+};
+
+template <class T>
+class FifoScheduler final : public Scheduler<T>
+{
+ public:
+    explicit FifoScheduler(size_t capacity);
+
+    void push(T&& x) override;
+
+    std::optional<T> take(size_t& lane) override;
+    void done(size_t) override
+    { }
+
+    std::optional<T> take_any() override;
+
+    bool ready() const override;
+    size_t size() const override;
+    bool empty() const override;
+
+ private:
+    Queue<T> queue_;
+};
+
+/// Elements with equal keys go to the same lane; a lane is processed
+/// by at most one worker at a time, so elements of one key are handled
+/// in order, and idle workers pick up any other lane with work pending
+template <class T, class KeyOf, class Hash>
+class PartitionedScheduler final : public Scheduler<T>
+{
+ public:
+    PartitionedScheduler(KeyOf key_of, size_t n_of_lanes);
+
+    void push(T&& x) override;
+
+    std::optional<T> take(size_t& lane) override;
+    void done(size_t lane) override;
+
+    std::optional<T> take_any() override;
+
+    bool ready() const override;
+    size_t size() const override;
+    bool empty() const override;
+
+ private:
+    struct Lane
+    {
+        Queue<T> queue;
+        bool     busy = false;
+    };
+
+    KeyOf             key_of_;
+    Hash              hash_;
+    std::vector<Lane> lanes_;
+
+    // lanes with waiting elements and no worker, may be stale
+    Queue<size_t> ready_;
+    size_t        size_;
+};
+
+/// Earliest deadline first: take() returns the waiting element with
+/// the nearest deadline_of(x), elements with equal deadlines in the
+/// order of arrival. A binary heap, as the manager's queue mutex
+/// already serializes every call
+template <class T, class DeadlineOf>
+class EdfScheduler final : public Scheduler<T>
+{
+ public:
+    explicit EdfScheduler(DeadlineOf deadline_of);
+
+    void push(T&& x) override;
+
+    std::optional<T> take(size_t& lane) override;
+    void done(size_t) override
+    { }
+
+    std::optional<T> take_any() override;
+
+    bool ready() const override;
+    size_t size() const override;
+    bool empty() const override;
+
+ private:
+    using deadline_t = std::chrono::steady_clock::time_point;
+
+    struct Entry
+    {
+        deadline_t deadline;
+        uint64_t   seq;
+        T          value;
+    };
+
+    DeadlineOf         deadline_of_;
+    std::vector<Entry> heap_;
+    uint64_t           seq_;
+
+    static bool later_(const Entry& a, const Entry& b);
+};
+
+template <class T>
+FifoScheduler<T>::FifoScheduler(size_t capacity)
+    : queue_(capacity)
+{ }
+
+template <class T>
+void FifoScheduler<T>::push(T&& x)
+{ queue_.emplace(std::move(x)); }
+
+template <class T>
+std::optional<T> FifoScheduler<T>::take(size_t& lane)
+{
+    lane = Scheduler<T>::NO_LANE;
+    return take_any();
+}
+
+template <class T>
+std::optional<T> FifoScheduler<T>::take_any()
+{
+    if (queue_.empty()) {
+        return std::nullopt;
+    }
+    return queue_.take_first();
+}
+
+template <class T>
+bool FifoScheduler<T>::ready() const
+{ return !queue_.empty(); }
+
+template <class T>
+size_t FifoScheduler<T>::size() const
+{ return queue_.size(); }
+
+template <class T>
+bool FifoScheduler<T>::empty() const
+{ return queue_.empty(); }
+
+template <class T, class KeyOf, class Hash>
+PartitionedScheduler<T, KeyOf, Hash>::PartitionedScheduler(
+    KeyOf key_of,
+    size_t n_of_lanes
+)
+    : key_of_(std::move(key_of)),
+      lanes_(n_of_lanes ? n_of_lanes : 1),
+      ready_(n_of_lanes),
+      size_(0)
+{ }
+
+template <class T, class KeyOf, class Hash>
+void PartitionedScheduler<T, KeyOf, Hash>::push(T&& x)
+{
+    size_t index = hash_(key_of_(x)) % lanes_.size();
+    Lane& lane = lanes_[index];
+
+    lane.queue.emplace(std::move(x));
+    if (!lane.busy && lane.queue.size() == 1) {
+        ready_.emplace(index);
+    }
+    ++size_;
+}
+
+template <class T, class KeyOf, class Hash>
+std::optional<T> PartitionedScheduler<T, KeyOf, Hash>::take(size_t& lane)
+{
+    while (!ready_.empty()) {
+        size_t index = ready_.take_first();
+        Lane& candidate = lanes_[index];
+        if (candidate.busy || candidate.queue.empty()) {
+            continue;
+        }
+
+        candidate.busy = true;
+        --size_;
+        lane = index;
+        return candidate.queue.take_first();
+    }
+    return std::nullopt;
+}
+
+template <class T, class KeyOf, class Hash>
+void PartitionedScheduler<T, KeyOf, Hash>::done(size_t lane)
+{
+    lanes_[lane].busy = false;
+    if (!lanes_[lane].queue.empty()) {
+        ready_.emplace(lane);
+    }
+}
+
+template <class T, class KeyOf, class Hash>
+std::optional<T> PartitionedScheduler<T, KeyOf, Hash>::take_any()
+{
+    for (auto& lane : lanes_) {
+        if (!lane.queue.empty()) {
+            --size_;
+            return lane.queue.take_first();
+        }
+    }
+    return std::nullopt;
+}
+
+template <class T, class KeyOf, class Hash>
+bool PartitionedScheduler<T, KeyOf, Hash>::ready() const
+{ return !ready_.empty(); }
+
+template <class T, class KeyOf, class Hash>
+size_t PartitionedScheduler<T, KeyOf, Hash>::size() const
+{ return size_; }
+
+template <class T, class KeyOf, class Hash>
+bool PartitionedScheduler<T, KeyOf, Hash>::empty() const
+{ return size_ == 0; }
+
+template <class T, class DeadlineOf>
+EdfScheduler<T, DeadlineOf>::EdfScheduler(DeadlineOf deadline_of)
+    : deadline_of_(std::move(deadline_of)),
+      seq_(0)
+{ }
+
+template <class T, class DeadlineOf>
+bool EdfScheduler<T, DeadlineOf>::later_(const Entry& a, const Entry& b)
+{ return a.deadline != b.deadline ? a.deadline > b.deadline : a.seq > b.seq; }
+
+template <class T, class DeadlineOf>
+void EdfScheduler<T, DeadlineOf>::push(T&& x)
+{
+    deadline_t deadline = deadline_of_(x);
+    heap_.push_back(Entry{deadline, seq_++, std::move(x)});
+    std::push_heap(heap_.begin(), heap_.end(), later_);
+}
+
+template <class T, class DeadlineOf>
+std::optional<T> EdfScheduler<T, DeadlineOf>::take(size_t& lane)
+{
+    lane = Scheduler<T>::NO_LANE;
+    return take_any();
+}
+
+template <class T, class DeadlineOf>
+std::optional<T> EdfScheduler<T, DeadlineOf>::take_any()
+{
+    if (heap_.empty()) {
+        return std::nullopt;
+    }
+    std::pop_heap(heap_.begin(), heap_.end(), later_);
+    std::optional<T> x(std::move(heap_.back().value));
+    heap_.pop_back();
+    return x;
+}
+
+template <class T, class DeadlineOf>
+bool EdfScheduler<T, DeadlineOf>::ready() const
+{ return !heap_.empty(); }
+
+template <class T, class DeadlineOf>
+size_t EdfScheduler<T, DeadlineOf>::size() const
+{ return heap_.size(); }
+
+template <class T, class DeadlineOf>
+bool EdfScheduler<T, DeadlineOf>::empty() const
+{ return heap_.empty(); }
+
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+/// Hash map split into independently locked shards,
+/// so that operations on different keys rarely contend
+template <class Key, class V, class Hash = std::hash<Key>>
+class ShardedMap
+{
+ public:
+    using map_t = std::unordered_map<Key, V, Hash>;
+
+    explicit ShardedMap(size_t n_of_shards = 64);
+
+    ShardedMap(const ShardedMap&) = delete;
+
+    /// Calls f(shard) with the shard owning key locked
+    template <class F>
+    decltype(auto) apply(const Key& key, F&& f);
+
+    /// Calls f(shard) for every shard, locking one shard at a time
+    template <class F>
+    void for_each_shard(F&& f);
+
+ private:
+    struct Shard
+    {
+        mutex_t mutex;
+        map_t   map;
+    };
+
+    std::vector<Shard> shards_;
+    Hash               hash_;
+};
+
+template <class Key, class V, class Hash>
+ShardedMap<Key, V, Hash>::ShardedMap(size_t n_of_shards)
+    : shards_(n_of_shards ? n_of_shards : 1)
+{
+    for (auto& shard : shards_) {
+        name_lock(shard.mutex, "sharded_map.shard");
+    }
+}
+
+template <class Key, class V, class Hash>
+template <class F>
+decltype(auto) ShardedMap<Key, V, Hash>::apply(const Key& key, F&& f)
+{
+    Shard& shard = shards_[hash_(key) % shards_.size()];
+    std::lock_guard<mutex_t> guard(shard.mutex);
+    return f(shard.map);
+}
+
+template <class Key, class V, class Hash>
+template <class F>
+void ShardedMap<Key, V, Hash>::for_each_shard(F&& f)
+{
+    for (auto& shard : shards_) {
+        std::lock_guard<mutex_t> guard(shard.mutex);
+        f(shard.map);
+    }
+}
+
+}
@@ -0,0 +1,567 @@
+#pragma once
+
+#include <system_error>
+#include <algorithm>
+#include <type_traits>
+#include <optional>
+#include <string>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+/// Elements are copied bytewise between address spaces
+template <class T>
+concept ShmElement = std::is_trivially_copyable_v<T> && std::is_default_constructible_v<T>;
+
+enum ShmRole
+{
+    SHM_PRODUCER,
+    SHM_CONSUMER
+};
+
+/// Bounded MPMC queue in a POSIX shared memory object, usable from
+/// several processes. Indices are lock-free (Vyukov's sequenced ring),
+/// waiters park on process-shared futexes. Each side records its pid,
+/// so a waiter can tell a dead peer from a slow one; a process killed
+/// in the middle of push() or pop() leaves its cell unusable
+template <ShmElement T>
+class ShmQueue
+{
+ public:
+    /// Fails with std::system_error if name exists, capacity is
+    /// rounded up to a power of two
+    static ShmQueue create(const std::string& name, size_t capacity, ShmRole role);
+    static ShmQueue open(const std::string& name, ShmRole role);
+    static void     unlink(const std::string& name);
+
+    ShmQueue(ShmQueue&& src) noexcept;
+    ShmQueue(const ShmQueue&) = delete;
+    ~ShmQueue();
+
+    bool try_push(const T& value);
+    bool try_pop(T& value);
+
+    /// Wait up to timeout for space or for an element
+    bool push(const T& value, std::chrono::nanoseconds timeout);
+    bool pop(T& value, std::chrono::nanoseconds timeout);
+
+    bool   empty() const;
+    size_t size() const;
+    size_t capacity() const;
+
+    /// False once the other side has closed the queue or its process
+    /// has exited, true while it has not attached yet
+    bool peer_alive() const;
+
+ private:
+    static constexpr uint64_t MAGIC = 0x67656e73686d7131;  // "genshmq1"
+
+    static constexpr int32_t NOT_ATTACHED = 0;
+    static constexpr int32_t DETACHED = -1;
+
+    struct Header
+    {
+        uint64_t magic;
+        uint64_t capacity;
+        uint64_t element_size;
+
+        alignas(64) std::atomic<uint64_t> enqueue_pos;
+        alignas(64) std::atomic<uint64_t> dequeue_pos;
+
+        // futex words, bumped after a push and after a pop
+        alignas(64) std::atomic<uint32_t> pushed;
+        std::atomic<uint32_t>             popped;
+        std::atomic<uint32_t>             waiting_consumers;
+        std::atomic<uint32_t>             waiting_producers;
+
+        std::atomic<int32_t> pids[2];  // by ShmRole
+    };
+
+    struct Cell
+    {
+        std::atomic<uint64_t> sequence;
+        T                     value;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free);
+    static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+    static constexpr size_t CELLS_OFFSET =
+        (sizeof(Header) + alignof(Cell) - 1) / alignof(Cell) * alignof(Cell);
+
+    Header* header_;
+    Cell*   cells_;
+    size_t  mapped_;
+    size_t  mask_;
+    ShmRole role_;
+
+    ShmQueue(void* memory, size_t mapped, ShmRole role);
+
+    static void* map_(int fd, size_t size);
+    static bool  process_alive_(int32_t pid);
+    static void  wait_(std::atomic<uint32_t>& word, uint32_t seen, std::chrono::nanoseconds timeout);
+    static void  wake_(std::atomic<uint32_t>& word);
+
+    template <class Try>
+    bool wait_for_(
+        Try attempt,
+        std::atomic<uint32_t>& word,
+        std::atomic<uint32_t>& waiting,
+        std::chrono::nanoseconds timeout
+    );
+};
+
+/// Resource reading a ShmQueue filled by another process,
+/// it must be the only reader of the queue. is_empty() takes the next
+/// element ahead, so a cell left unpublished by a producer killed in
+/// push() reads as empty instead of blocking get_data()
+template <ShmElement T>
+class ShmResource
+{
+ public:
+    explicit ShmResource(ShmQueue<T>&& queue);
+
+    /// Waits for an element if none was taken ahead, fails with
+    /// std::system_error (EPIPE) once the producer is gone
+    T    get_data();
+    bool is_empty();
+
+    ShmQueue<T>& queue();
+
+ private:
+    ShmQueue<T>      queue_;
+    std::optional<T> next_;  // popped by is_empty(), returned by get_data()
+};
+
+/// Handler writing elements to a ShmQueue read by another process.
+/// It waits while the queue is full, gives elements back to the manager
+/// when stopped and drops them, counted by lost(), if the reader is gone
+template <ShmElement T>
+class ShmSink
+{
+ public:
+    explicit ShmSink(
+        ShmQueue<T>&& queue,
+        std::chrono::nanoseconds poll_interval = std::chrono::milliseconds(20)
+    );
+
+    void process(T&& value);
+    void process(T&& value, std::stop_token token);
+
+    uint64_t     lost() const;
+    ShmQueue<T>& queue();
+
+ private:
+    ShmQueue<T>              queue_;
+    std::chrono::nanoseconds poll_interval_;
+    std::atomic<uint64_t>    lost_;
+};
+
+template <ShmElement T>
+ShmQueue<T> ShmQueue<T>::create(const std::string& name, size_t capacity, ShmRole role)
+{
+    size_t n = 2;
+    while (n < capacity) {
+        n <<= 1;
+    }
+    size_t size = CELLS_OFFSET + n * sizeof(Cell);
+
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+    }
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        int error = errno;
+        close(fd);
+        shm_unlink(name.c_str());
+        throw std::system_error(error, std::generic_category(), "ftruncate " + name);
+    }
+    void* memory = map_(fd, size);
+
+    auto* header = new (memory) Header();
+    header->capacity = n;
+    header->element_size = sizeof(T);
+    header->enqueue_pos.store(0, std::memory_order_relaxed);
+    header->dequeue_pos.store(0, std::memory_order_relaxed);
+    header->pushed.store(0, std::memory_order_relaxed);
+    header->popped.store(0, std::memory_order_relaxed);
+    header->waiting_consumers.store(0, std::memory_order_relaxed);
+    header->waiting_producers.store(0, std::memory_order_relaxed);
+    header->pids[SHM_PRODUCER].store(NOT_ATTACHED, std::memory_order_relaxed);
+    header->pids[SHM_CONSUMER].store(NOT_ATTACHED, std::memory_order_relaxed);
+
+    auto* cells = reinterpret_cast<Cell*>(static_cast<char*>(memory) + CELLS_OFFSET);
+    for (size_t i = 0; i < n; ++i) {
+        new (&cells[i]) Cell();
+        cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = MAGIC;
+
+    return ShmQueue(memory, size, role);
+}
+
+template <ShmElement T>
+ShmQueue<T> ShmQueue<T>::open(const std::string& name, ShmRole role)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "shm_open " + name);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        int error = errno;
+        close(fd);
+        throw std::system_error(error, std::generic_category(), "fstat " + name);
+    }
+
+    auto size = static_cast<size_t>(st.st_size);
+    if (size < CELLS_OFFSET) {
+        close(fd);
+        throw std::system_error(EINVAL, std::generic_category(), "not a queue " + name);
+    }
+    void* memory = map_(fd, size);
+
+    auto* header = static_cast<Header*>(memory);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != MAGIC
+        || header->element_size != sizeof(T)
+        || CELLS_OFFSET + header->capacity * sizeof(Cell) > size) {
+        munmap(memory, size);
+        throw std::system_error(EINVAL, std::generic_category(), "not a queue of T " + name);
+    }
+
+    return ShmQueue(memory, size, role);
+}
+
+template <ShmElement T>
+void ShmQueue<T>::unlink(const std::string& name)
+{ shm_unlink(name.c_str()); }
+
+template <ShmElement T>
+void* ShmQueue<T>::map_(int fd, size_t size)
+{
+    void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    close(fd);
+    if (memory == MAP_FAILED) {
+        throw std::system_error(error, std::generic_category(), "mmap");
+    }
+    return memory;
+}
+
+template <ShmElement T>
+ShmQueue<T>::ShmQueue(void* memory, size_t mapped, ShmRole role)
+    : header_(static_cast<Header*>(memory)),
+      cells_(reinterpret_cast<Cell*>(static_cast<char*>(memory) + CELLS_OFFSET)),
+      mapped_(mapped),
+      mask_(header_->capacity - 1),
+      role_(role)
+{ header_->pids[role_].store(static_cast<int32_t>(getpid()), std::memory_order_release); }
+
+template <ShmElement T>
+ShmQueue<T>::ShmQueue(ShmQueue&& src) noexcept
+    : header_(src.header_),
+      cells_(src.cells_),
+      mapped_(src.mapped_),
+      mask_(src.mask_),
+      role_(src.role_)
+{ src.header_ = nullptr; }
+
+template <ShmElement T>
+ShmQueue<T>::~ShmQueue()
+{
+    if (!header_) {
+        return;
+    }
+
+    int32_t self = static_cast<int32_t>(getpid());
+    header_->pids[role_].compare_exchange_strong(self, DETACHED, std::memory_order_acq_rel);
+    // wake the peer so it notices
+    wake_(header_->pushed);
+    wake_(header_->popped);
+
+    munmap(header_, mapped_);
+}
+
+template <ShmElement T>
+bool ShmQueue<T>::try_push(const T& value)
+{
+    uint64_t pos = header_->enqueue_pos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells_[pos & mask_];
+        uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<int64_t>(seq - pos);
+        if (diff == 0) {
+            if (header_->enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = header_->enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->value = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+
+    header_->pushed.fetch_add(1, std::memory_order_seq_cst);
+    if (header_->waiting_consumers.load(std::memory_order_seq_cst) != 0) {
+        wake_(header_->pushed);
+    }
+    return true;
+}
+
+template <ShmElement T>
+bool ShmQueue<T>::try_pop(T& value)
+{
+    uint64_t pos = header_->dequeue_pos.load(std::memory_order_relaxed);
+    Cell* cell;
+    while (true) {
+        cell = &cells_[pos & mask_];
+        uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+        auto diff = static_cast<int64_t>(seq - (pos + 1));
+        if (diff == 0) {
+            if (header_->dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = header_->dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    value = cell->value;
+    cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+
+    header_->popped.fetch_add(1, std::memory_order_seq_cst);
+    if (header_->waiting_producers.load(std::memory_order_seq_cst) != 0) {
+        wake_(header_->popped);
+    }
+    return true;
+}
+
+template <ShmElement T>
+template <class Try>
+bool ShmQueue<T>::wait_for_(
+    Try attempt,
+    std::atomic<uint32_t>& word,
+    std::atomic<uint32_t>& waiting,
+    std::chrono::nanoseconds timeout
+)
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        if (attempt()) {
+            return true;
+        }
+
+        uint32_t seen = word.load(std::memory_order_seq_cst);
+        waiting.fetch_add(1, std::memory_order_seq_cst);
+        bool done = attempt();
+        if (!done) {
+            auto left = deadline - std::chrono::steady_clock::now();
+            if (left > std::chrono::nanoseconds::zero() && peer_alive()) {
+                wait_(word, seen, left);
+            }
+        }
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+
+        if (done) {
+            return true;
+        }
+        if (std::chrono::steady_clock::now() >= deadline || !peer_alive()) {
+            return attempt();
+        }
+    }
+}
+
+template <ShmElement T>
+bool ShmQueue<T>::push(const T& value, std::chrono::nanoseconds timeout)
+{
+    return wait_for_(
+        [&] { return try_push(value); },
+        header_->popped,
+        header_->waiting_producers,
+        timeout
+    );
+}
+
+template <ShmElement T>
+bool ShmQueue<T>::pop(T& value, std::chrono::nanoseconds timeout)
+{
+    return wait_for_(
+        [&] { return try_pop(value); },
+        header_->pushed,
+        header_->waiting_consumers,
+        timeout
+    );
+}
+
+template <ShmElement T>
+bool ShmQueue<T>::empty() const
+{ return size() == 0; }
+
+template <ShmElement T>
+size_t ShmQueue<T>::size() const
+{
+    uint64_t head = header_->dequeue_pos.load(std::memory_order_acquire);
+    uint64_t tail = header_->enqueue_pos.load(std::memory_order_acquire);
+    return tail > head ? static_cast<size_t>(tail - head) : 0;
+}
+
+template <ShmElement T>
+size_t ShmQueue<T>::capacity() const
+{ return mask_ + 1; }
+
+template <ShmElement T>
+bool ShmQueue<T>::peer_alive() const
+{
+    int32_t pid = header_->pids[role_ == SHM_PRODUCER ? SHM_CONSUMER : SHM_PRODUCER]
+        .load(std::memory_order_acquire);
+    if (pid == NOT_ATTACHED) {
+        return true;
+    }
+    if (pid == DETACHED) {
+        return false;
+    }
+    return process_alive_(pid);
+}
+
+template <ShmElement T>
+bool ShmQueue<T>::process_alive_(int32_t pid)
+{
+    if (kill(pid, 0) != 0 && errno != EPERM) {
+        return false;
+    }
+
+    // a crashed process stays a zombie until its parent reaps it
+    char path[32];
+    std::snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        return true;
+    }
+    char stat[256];
+    ssize_t n = read(fd, stat, sizeof(stat) - 1);
+    close(fd);
+    if (n <= 0) {
+        return true;
+    }
+    stat[n] = '\0';
+
+    const char* state = std::strrchr(stat, ')');
+    return !state || (state[1] != ' ' || (state[2] != 'Z' && state[2] != 'X'));
+}
+
+template <ShmElement T>
+void ShmQueue<T>::wait_(std::atomic<uint32_t>& word, uint32_t seen, std::chrono::nanoseconds timeout)
+{
+    // not FUTEX_PRIVATE_FLAG, the word is shared between processes;
+    // the timeout bounds the wait so a dead peer is noticed
+    auto ns = std::min<int64_t>(timeout.count(), INT32_MAX);
+    struct timespec ts;
+    ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+    ts.tv_nsec = static_cast<long>(ns % 1000000000);
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, &ts, nullptr, 0);
+}
+
+template <ShmElement T>
+void ShmQueue<T>::wake_(std::atomic<uint32_t>& word)
+{ syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0); }
+
+template <ShmElement T>
+ShmResource<T>::ShmResource(ShmQueue<T>&& queue)
+    : queue_(std::move(queue))
+{ }
+
+template <ShmElement T>
+T ShmResource<T>::get_data()
+{
+    T value;
+    if (next_) {
+        value = *next_;
+        next_.reset();
+        return value;
+    }
+
+    while (!queue_.pop(value, std::chrono::milliseconds(20))) {
+        if (!queue_.peer_alive()) {
+            // it may have published its last element after pop() gave up
+            if (queue_.try_pop(value)) {
+                break;
+            }
+            throw std::system_error(EPIPE, std::generic_category(), "shm queue producer is gone");
+        }
+    }
+    return value;
+}
+
+template <ShmElement T>
+bool ShmResource<T>::is_empty()
+{
+    // empty() counts claimed cells, a dead producer's one is never published
+    T value;
+    if (!next_ && queue_.try_pop(value)) {
+        next_ = value;
+    }
+    return !next_;
+}
+
+template <ShmElement T>
+ShmQueue<T>& ShmResource<T>::queue()
+{ return queue_; }
+
+template <ShmElement T>
+ShmSink<T>::ShmSink(ShmQueue<T>&& queue, std::chrono::nanoseconds poll_interval)
+    : queue_(std::move(queue)),
+      poll_interval_(poll_interval),
+      lost_(0)
+{ }
+
+template <ShmElement T>
+void ShmSink<T>::process(T&& value)
+{ process(std::move(value), std::stop_token()); }
+
+template <ShmElement T>
+void ShmSink<T>::process(T&& value, std::stop_token token)
+{
+    while (!queue_.push(value, poll_interval_)) {
+        if (token.stop_requested()) {
+            throw OperationCancelled();
+        }
+        if (!queue_.peer_alive()) {
+            lost_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+template <ShmElement T>
+uint64_t ShmSink<T>::lost() const
+{ return lost_.load(std::memory_order_relaxed); }
+
+template <ShmElement T>
+ShmQueue<T>& ShmSink<T>::queue()
+{ return queue_; }
+
+}
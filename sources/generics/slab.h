@@ -0,0 +1,170 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+/// Pool of reusable objects addressed by 32-bit indices.
+/// Objects are allocated in chunks which are never freed while
+/// the slab lives, so acquire() and release() only touch a
+/// lock-free free list; a mutex is taken when a chunk is added.
+template <class T, size_t CHUNK_SIZE = 256>
+class Slab
+{
+ public:
+    using index_t = uint32_t;
+
+    static constexpr index_t NONE = UINT32_MAX;
+
+    explicit Slab(size_t max_size = (size_t(1) << 24));
+    ~Slab();
+
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    /// Returns index of a free object or NONE if max_size is reached
+    index_t acquire();
+    void release(index_t index) noexcept;
+
+    T& operator[](index_t index) noexcept;
+    const T& operator[](index_t index) const noexcept;
+
+    /// Number of objects allocated so far
+    size_t capacity() const noexcept;
+
+ private:
+    struct Node
+    {
+        T                    value;
+        std::atomic<index_t> next;
+    };
+
+    std::unique_ptr<std::atomic<Node*>[]> chunks_;
+    size_t                                max_chunks_;
+    std::atomic<size_t>                   n_of_chunks_;
+
+    // (tag << 32) | (index + 1), zero means empty
+    std::atomic<uint64_t> free_head_;
+
+    mutex_t grow_mutex_;
+
+    Node& node_(index_t index) const noexcept;
+    void push_free_(index_t index) noexcept;
+    index_t pop_free_() noexcept;
+    index_t grow_();
+};
+
+template <class T, size_t CHUNK_SIZE>
+Slab<T, CHUNK_SIZE>::Slab(size_t max_size)
+    : max_chunks_((max_size + CHUNK_SIZE - 1) / CHUNK_SIZE),
+      n_of_chunks_(0),
+      free_head_(0)
+{
+    name_lock(grow_mutex_, "slab.grow");
+    chunks_ = std::make_unique<std::atomic<Node*>[]>(max_chunks_);
+    for (size_t i = 0; i < max_chunks_; ++i) {
+        chunks_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+template <class T, size_t CHUNK_SIZE>
+Slab<T, CHUNK_SIZE>::~Slab()
+{
+    size_t n = n_of_chunks_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < n; ++i) {
+        delete[] chunks_[i].load(std::memory_order_relaxed);
+    }
+}
+
+template <class T, size_t CHUNK_SIZE>
+typename Slab<T, CHUNK_SIZE>::index_t Slab<T, CHUNK_SIZE>::acquire()
+{
+    index_t index = pop_free_();
+    return (index != NONE) ? index : grow_();
+}
+
+template <class T, size_t CHUNK_SIZE>
+void Slab<T, CHUNK_SIZE>::release(index_t index) noexcept
+{ push_free_(index); }
+
+template <class T, size_t CHUNK_SIZE>
+T& Slab<T, CHUNK_SIZE>::operator[](index_t index) noexcept
+{ return node_(index).value; }
+
+template <class T, size_t CHUNK_SIZE>
+const T& Slab<T, CHUNK_SIZE>::operator[](index_t index) const noexcept
+{ return node_(index).value; }
+
+template <class T, size_t CHUNK_SIZE>
+size_t Slab<T, CHUNK_SIZE>::capacity() const noexcept
+{ return n_of_chunks_.load(std::memory_order_relaxed) * CHUNK_SIZE; }
+
+template <class T, size_t CHUNK_SIZE>
+typename Slab<T, CHUNK_SIZE>::Node&
+Slab<T, CHUNK_SIZE>::node_(index_t index) const noexcept
+{
+    Node* chunk = chunks_[index / CHUNK_SIZE].load(std::memory_order_acquire);
+    return chunk[index % CHUNK_SIZE];
+}
+
+template <class T, size_t CHUNK_SIZE>
+void Slab<T, CHUNK_SIZE>::push_free_(index_t index) noexcept
+{
+    Node& node = node_(index);
+    uint64_t head = free_head_.load(std::memory_order_relaxed);
+    uint64_t next;
+    do {
+        node.next.store(static_cast<index_t>(head), std::memory_order_relaxed);
+        next = ((head >> 32) + 1) << 32 | (uint64_t(index) + 1);
+    } while (!free_head_.compare_exchange_weak(
+        head, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <class T, size_t CHUNK_SIZE>
+typename Slab<T, CHUNK_SIZE>::index_t Slab<T, CHUNK_SIZE>::pop_free_() noexcept
+{
+    uint64_t head = free_head_.load(std::memory_order_acquire);
+    uint64_t next;
+    do {
+        auto top = static_cast<index_t>(head);
+        if (top == 0) {
+            return NONE;
+        }
+        index_t after = node_(top - 1).next.load(std::memory_order_relaxed);
+        next = ((head >> 32) + 1) << 32 | after;
+    } while (!free_head_.compare_exchange_weak(
+        head, next, std::memory_order_acquire, std::memory_order_acquire));
+
+    return static_cast<index_t>(head) - 1;
+}
+
+template <class T, size_t CHUNK_SIZE>
+typename Slab<T, CHUNK_SIZE>::index_t Slab<T, CHUNK_SIZE>::grow_()
+{
+    lock_t lock(grow_mutex_);
+
+    index_t index = pop_free_();
+    if (index != NONE) {
+        return index;
+    }
+
+    size_t n = n_of_chunks_.load(std::memory_order_relaxed);
+    if (n == max_chunks_) {
+        return NONE;
+    }
+
+    chunks_[n].store(new Node[CHUNK_SIZE], std::memory_order_release);
+    n_of_chunks_.store(n + 1, std::memory_order_release);
+
+    auto first = static_cast<index_t>(n * CHUNK_SIZE);
+    for (index_t i = CHUNK_SIZE - 1; i > 0; --i) {
+        push_free_(first + i);
+    }
+    return first;
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+namespace gen
+{
+
+struct ManagerStats
+{
+    std::size_t   n_of_threads;
+    std::size_t   pending;
+    std::uint64_t received;
+    std::uint64_t processed;
+    std::uint64_t coalesced;  // merged into a waiting element
+    std::uint64_t requeued;   // given up by cancelled handlers
+    std::uint64_t rejected;   // dropped by the rate limiter
+    std::uint64_t delayed;    // waited for a rate limiter token
+    std::uint64_t overflowed; // passed to the overflow callback
+    std::uint64_t expired;    // dropped after their deadline
+    std::uint64_t stuck;      // handler calls flagged by the watchdog
+    std::uint64_t replaced;   // workers started in place of stuck ones
+    std::uint64_t hedged;     // elements dispatched a second time
+    std::uint64_t replayed;   // not acked in the journal, queued again
+    std::uint64_t synced;     // journal group commits
+    std::uint64_t batches;    // batches taken by workers
+    std::size_t   batch_size; // current batch limit of the controller
+    std::uint64_t linger_us;  // current wait to fill a batch
+    std::uint64_t scale_ups;  // workers added by autoscaling
+    std::uint64_t scale_downs;
+    std::size_t   bytes;        // footprint of waiting elements
+    std::size_t   backup;       // saved to backups, not restored yet
+    std::size_t   backup_bytes; // footprint of those
+};
+
+/// Composition of the elements waiting in a manager's queue
+struct PendingSnapshot
+{
+    std::size_t                pending;
+    std::vector<std::size_t>   per_class;
+    std::chrono::milliseconds  oldest_age;
+
+    // most frequent keys with their counts, in descending order
+    std::vector<std::pair<std::uint64_t, std::size_t>> top_keys;
+
+    // false if writers kept changing the queue during every attempt,
+    // then the figures may belong to slightly different moments
+    bool consistent;
+};
+
+}
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+struct TraceEvent
+{
+    const char* name;
+    uint64_t    id;
+    int64_t     begin;  // nanoseconds since the tracer was created
+    int64_t     end;
+    char        phase;  // 'X' complete, 'b' / 'e' async begin / end
+};
+
+/// Single-producer single-consumer ring of trace events: the owning
+/// thread pushes, write_json() pops; a full ring drops new events
+class TraceRing
+{
+ public:
+    TraceRing(size_t capacity, const char* thread_name, size_t tid);
+
+    bool push(const TraceEvent& event);
+    bool pop(TraceEvent& event);
+
+    const char* thread_name() const;
+    size_t      tid() const;
+
+ private:
+    std::vector<TraceEvent> events_;
+    const char*             thread_name_;
+    size_t                  tid_;
+
+    alignas(64) std::atomic<size_t> head_;  // next event to pop
+    alignas(64) std::atomic<size_t> tail_;  // next event to push
+};
+
+/// Records sampled lifecycles of elements into per-thread rings and
+/// writes them as Chrome trace-event JSON, loadable by Perfetto and
+/// chrome://tracing. One tracer may be shared by several managers
+class Tracer
+{
+ public:
+    explicit Tracer(size_t sample_every = 100, size_t ring_capacity = 1 << 14);
+
+    Tracer(const Tracer&) = delete;
+
+    /// Returns a trace id for every sample_every-th call, 0 otherwise
+    uint64_t sample();
+
+    int64_t now() const;
+
+    /// thread_name labels the calling thread's track on its first event
+    void complete(const char* name, uint64_t id, int64_t begin, int64_t end, const char* thread_name);
+    void async_begin(const char* name, uint64_t id, const char* thread_name);
+    void async_end(const char* name, uint64_t id, const char* thread_name);
+
+    /// Moves recorded events to out, can be called while recording
+    void write_json(std::ostream& out);
+
+    uint64_t dropped() const;
+
+ private:
+    const uint64_t                          id_;
+    const size_t                            sample_every_;
+    const size_t                            ring_capacity_;
+    const std::chrono::steady_clock::time_point origin_;
+
+    std::atomic<uint64_t> counter_;
+    std::atomic<uint64_t> dropped_;
+
+    mutex_t                                 rings_mutex_;
+    std::vector<std::unique_ptr<TraceRing>> rings_;
+
+    void record_(const TraceEvent& event, const char* thread_name);
+    TraceRing& ring_(const char* thread_name);
+
+    static std::atomic<uint64_t>& next_id_();
+};
+
+inline TraceRing::TraceRing(size_t capacity, const char* thread_name, size_t tid)
+    : events_(capacity ? capacity : 1),
+      thread_name_(thread_name),
+      tid_(tid),
+      head_(0),
+      tail_(0)
+{ }
+
+inline bool TraceRing::push(const TraceEvent& event)
+{
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == events_.size()) {
+        return false;
+    }
+    events_[tail % events_.size()] = event;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+inline bool TraceRing::pop(TraceEvent& event)
+{
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events_[head % events_.size()];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+}
+
+inline const char* TraceRing::thread_name() const
+{ return thread_name_; }
+
+inline size_t TraceRing::tid() const
+{ return tid_; }
+
+inline Tracer::Tracer(size_t sample_every, size_t ring_capacity)
+    : id_(next_id_()++),
+      sample_every_(sample_every ? sample_every : 1),
+      ring_capacity_(ring_capacity),
+      origin_(std::chrono::steady_clock::now()),
+      counter_(0),
+      dropped_(0)
+{ name_lock(rings_mutex_, "tracer.rings"); }
+
+inline std::atomic<uint64_t>& Tracer::next_id_()
+{
+    static std::atomic<uint64_t> id{1};
+    return id;
+}
+
+inline uint64_t Tracer::sample()
+{
+    uint64_t n = counter_.fetch_add(1, std::memory_order_relaxed) + 1;
+    return n % sample_every_ == 0 ? n : 0;
+}
+
+inline int64_t Tracer::now() const
+{ return (std::chrono::steady_clock::now() - origin_).count(); }
+
+inline uint64_t Tracer::dropped() const
+{ return dropped_.load(std::memory_order_relaxed); }
+
+inline TraceRing& Tracer::ring_(const char* thread_name)
+{
+    // a thread keeps the ring of the tracer it used last,
+    // switching between tracers costs a locked lookup
+    struct Cached
+    {
+        uint64_t   tracer = 0;
+        TraceRing* ring = nullptr;
+    };
+    thread_local Cached cached;
+    thread_local std::vector<std::pair<uint64_t, TraceRing*>> owned;
+
+    if (cached.tracer == id_) {
+        return *cached.ring;
+    }
+
+    TraceRing* ring = nullptr;
+    for (auto& [tracer, r] : owned) {
+        if (tracer == id_) {
+            ring = r;
+        }
+    }
+    if (!ring) {
+        lock_t lock(rings_mutex_);
+        rings_.push_back(std::make_unique<TraceRing>(ring_capacity_, thread_name, rings_.size() + 1));
+        ring = rings_.back().get();
+        owned.emplace_back(id_, ring);
+    }
+
+    cached = Cached{id_, ring};
+    return *ring;
+}
+
+inline void Tracer::record_(const TraceEvent& event, const char* thread_name)
+{
+    if (!ring_(thread_name).push(event)) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+inline void Tracer::complete(
+    const char* name,
+    uint64_t id,
+    int64_t begin,
+    int64_t end,
+    const char* thread_name
+)
+{ record_(TraceEvent{name, id, begin, end, 'X'}, thread_name); }
+
+inline void Tracer::async_begin(const char* name, uint64_t id, const char* thread_name)
+{
+    int64_t t = now();
+    record_(TraceEvent{name, id, t, t, 'b'}, thread_name);
+}
+
+inline void Tracer::async_end(const char* name, uint64_t id, const char* thread_name)
+{
+    int64_t t = now();
+    record_(TraceEvent{name, id, t, t, 'e'}, thread_name);
+}
+
+inline void Tracer::write_json(std::ostream& out)
+{
+    auto us = [](int64_t ns) { return static_cast<double>(ns) / 1000; };
+
+    lock_t lock(rings_mutex_);
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const char* separator = "\n";
+
+    for (auto& ring : rings_) {
+        out << separator
+            << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << ring->tid()
+            << ",\"args\":{\"name\":\"" << ring->thread_name() << ' ' << ring->tid() << "\"}}";
+        separator = ",\n";
+
+        TraceEvent event;
+        while (ring->pop(event)) {
+            out << separator
+                << "{\"ph\":\"" << event.phase
+                << "\",\"name\":\"" << event.name
+                << "\",\"cat\":\"item\",\"pid\":1,\"tid\":" << ring->tid()
+                << ",\"ts\":" << us(event.begin);
+            if (event.phase == 'X') {
+                out << ",\"dur\":" << us(event.end - event.begin);
+            } else {
+                out << ",\"id\":" << event.id;
+            }
+            out << ",\"args\":{\"item\":" << event.id << "}}";
+        }
+    }
+
+    out << "\n]}\n";
+}
+
+}
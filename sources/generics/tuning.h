@@ -0,0 +1,241 @@
+#pragma once
+
+#include <functional>
+#include <iomanip>
+#include <ostream>
+#include <memory>
+#include <vector>
+#include <tuple>
+
+#include "manager.h"
+
+namespace gen
+{
+
+/// Values tried for each setting, every combination is one trial
+struct TuningSpace
+{
+    std::vector<size_t>       n_of_threads = {2, 4, 8, 16};
+    std::vector<size_t>       queue_sizes = {64, 256, 1024};
+    std::vector<WaitStrategy> wait_strategies = {WAIT_BLOCK, WAIT_SPIN_PARK};
+
+    // 1 processes elements one by one, more enables batching
+    // with that max_batch
+    std::vector<size_t> max_batches = {1};
+};
+
+struct TuningOptions
+{
+    // a trial ends when this many elements are processed
+    // or after max_trial, whichever comes first
+    size_t                    elements = 10000;
+    std::chrono::milliseconds max_trial = std::chrono::milliseconds(2000);
+
+    // configurations over this p99 latency are not recommended,
+    // 0 for no limit; also the target of batching trials
+    std::chrono::milliseconds p99_target = std::chrono::milliseconds(0);
+
+    // throughput within this share of the best counts as equal,
+    // then the configuration with fewer threads, a shorter queue,
+    // blocking waits and smaller batches is recommended
+    double tolerance = 0.05;
+};
+
+struct TuningConfig
+{
+    size_t       n_of_threads;
+    size_t       queue_size;
+    WaitStrategy wait_strategy;
+    size_t       max_batch;
+};
+
+struct TuningTrial
+{
+    TuningConfig config;
+    uint64_t     processed;
+    double       throughput;  // elements per second
+    double       p50_ms;      // receipt to completion, bucket bounds
+    double       p99_ms;
+};
+
+struct TuningReport
+{
+    std::vector<TuningTrial> trials;
+    TuningConfig             recommended;
+    bool                     found;  // some trial met the p99 target
+
+    void write(std::ostream& out) const;
+};
+
+/// Sweeps manager configurations for a resource and handler pair:
+/// each trial runs a manager over fresh ones from the factories,
+/// measures throughput and latency percentiles, and the report
+/// recommends the cheapest configuration close to the best
+/// throughput that meets the p99 target
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+class Tuner
+{
+ public:
+    using resource_factory_t = std::function<std::unique_ptr<Res>()>;
+    using handler_factory_t = std::function<std::unique_ptr<H>()>;
+
+    Tuner(
+        resource_factory_t make_resource,
+        handler_factory_t make_handler,
+        TuningOptions options = TuningOptions()
+    );
+
+    TuningReport run(const TuningSpace& space);
+    TuningTrial  trial(const TuningConfig& config);
+
+ private:
+    resource_factory_t make_resource_;
+    handler_factory_t  make_handler_;
+    TuningOptions      options_;
+
+    TuningReport recommend_(std::vector<TuningTrial> trials) const;
+};
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+Tuner<Res, H>::Tuner(
+    resource_factory_t make_resource,
+    handler_factory_t make_handler,
+    TuningOptions options
+)
+    : make_resource_(std::move(make_resource)),
+      make_handler_(std::move(make_handler)),
+      options_(options)
+{ }
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+TuningReport Tuner<Res, H>::run(const TuningSpace& space)
+{
+    std::vector<TuningTrial> trials;
+    for (size_t n_of_threads : space.n_of_threads) {
+        for (size_t queue_size : space.queue_sizes) {
+            for (WaitStrategy wait : space.wait_strategies) {
+                for (size_t max_batch : space.max_batches) {
+                    trials.push_back(trial(TuningConfig{n_of_threads, queue_size, wait, max_batch}));
+                }
+            }
+        }
+    }
+    return recommend_(std::move(trials));
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+TuningTrial Tuner<Res, H>::trial(const TuningConfig& config)
+{
+    using clock = std::chrono::steady_clock;
+
+    std::unique_ptr<Res> resource = make_resource_();
+    std::unique_ptr<H>   handler = make_handler_();
+
+    BasicResourceManager<Res, H> manager(*resource, *handler, config.queue_size, config.n_of_threads);
+    manager.set_wait_strategy(config.wait_strategy);
+    manager.enable_latency_histogram();
+    if (config.max_batch > 1) {
+        BatchPolicy policy;
+        policy.max_batch = config.max_batch;
+        if (options_.p99_target.count() > 0) {
+            policy.p99_target = options_.p99_target;
+        }
+        manager.enable_batching(policy);
+    }
+
+    auto begin = clock::now();
+    manager.start();
+    while (manager.stats().processed < options_.elements && clock::now() - begin < options_.max_trial) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    double elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+    uint64_t processed = manager.stats().processed;
+    manager.stop();
+
+    Queue<resource_data_t<Res>> unprocessed;
+    manager.save_session_data(unprocessed);
+
+    const DurationHistogram& latency = *manager.latency();
+    return TuningTrial{
+        config,
+        processed,
+        static_cast<double>(processed) / elapsed,
+        static_cast<double>(latency.quantile(0.5)) / 1e6,
+        static_cast<double>(latency.quantile(0.99)) / 1e6
+    };
+}
+
+template <ResourceLike Res, HandlerFor<resource_data_t<Res>> H>
+TuningReport Tuner<Res, H>::recommend_(std::vector<TuningTrial> trials) const
+{
+    auto eligible = [&](const TuningTrial& t) {
+        return t.processed > 0
+            && (options_.p99_target.count() == 0
+                || t.p99_ms <= static_cast<double>(options_.p99_target.count()));
+    };
+
+    double best = 0;
+    for (const auto& t : trials) {
+        if (eligible(t)) {
+            best = std::max(best, t.throughput);
+        }
+    }
+
+    const TuningTrial* pick = nullptr;
+    for (const auto& t : trials) {
+        if (!eligible(t) || t.throughput < best * (1 - options_.tolerance)) {
+            continue;
+        }
+        auto cost = [](const TuningTrial* x) {
+            return std::make_tuple(
+                x->config.n_of_threads,
+                x->config.queue_size,
+                x->config.wait_strategy == WAIT_SPIN_PARK,
+                x->config.max_batch,
+                -x->throughput
+            );
+        };
+        if (!pick || cost(&t) < cost(pick)) {
+            pick = &t;
+        }
+    }
+
+    TuningReport report{std::move(trials), TuningConfig{}, pick != nullptr};
+    if (pick) {
+        report.recommended = pick->config;
+    }
+    return report;
+}
+
+inline void TuningReport::write(std::ostream& out) const
+{
+    auto wait_name = [](WaitStrategy w) { return w == WAIT_SPIN_PARK ? "spin-park" : "block"; };
+
+    out << std::setw(8) << "threads"
+        << std::setw(8) << "queue"
+        << std::setw(11) << "wait"
+        << std::setw(7) << "batch"
+        << std::setw(14) << "elements/s"
+        << std::setw(10) << "p50 ms"
+        << std::setw(10) << "p99 ms" << "\n";
+
+    for (const auto& t : trials) {
+        out << std::setw(8) << t.config.n_of_threads
+            << std::setw(8) << t.config.queue_size
+            << std::setw(11) << wait_name(t.config.wait_strategy)
+            << std::setw(7) << t.config.max_batch
+            << std::setw(14) << std::fixed << std::setprecision(1) << t.throughput
+            << std::setw(10) << std::setprecision(3) << t.p50_ms
+            << std::setw(10) << t.p99_ms << "\n";
+    }
+
+    if (found) {
+        out << "recommended: " << recommended.n_of_threads << " threads, queue "
+            << recommended.queue_size << ", " << wait_name(recommended.wait_strategy)
+            << ", batch " << recommended.max_batch << "\n";
+    } else {
+        out << "recommended: none meets the p99 target\n";
+    }
+}
+
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "gendef.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace gen
+{
+
+struct SpinPolicy
+{
+    size_t spins  = 2000;  // busy iterations with a pause hint
+    size_t yields = 16;    // sched_yield() calls before parking
+};
+
+/// Tells the core that the thread is spinning,
+/// which saves power and the sibling hyperthread's cycles
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/// Eventcount: waiters remember the epoch, check their condition and
+/// wait until the epoch changes; notifiers bump the epoch after making
+/// the condition true. The epoch is a 32-bit atomic, so parking is a
+/// plain futex wait, and notifiers skip the wake syscall while nobody
+/// is parked
+class EventCount
+{
+ public:
+    EventCount();
+
+    uint32_t epoch() const;
+
+    /// Returns when the epoch differs from seen
+    void await(uint32_t seen, const SpinPolicy& policy);
+
+    void notify_one();
+    void notify_all();
+
+ private:
+    std::atomic<uint32_t> epoch_;
+    std::atomic<uint32_t> parked_;
+};
+
+inline EventCount::EventCount()
+    : epoch_(0),
+      parked_(0)
+{ }
+
+inline uint32_t EventCount::epoch() const
+{ return epoch_.load(std::memory_order_acquire); }
+
+inline void EventCount::await(uint32_t seen, const SpinPolicy& policy)
+{
+    for (size_t i = 0; i < policy.spins; ++i) {
+        if (epoch_.load(std::memory_order_acquire) != seen) {
+            return;
+        }
+        cpu_relax();
+    }
+    for (size_t i = 0; i < policy.yields; ++i) {
+        if (epoch_.load(std::memory_order_acquire) != seen) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    parked_.fetch_add(1, std::memory_order_seq_cst);
+    while (epoch_.load(std::memory_order_seq_cst) == seen) {
+        epoch_.wait(seen, std::memory_order_seq_cst);
+    }
+    parked_.fetch_sub(1, std::memory_order_relaxed);
+}
+
+inline void EventCount::notify_one()
+{
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_seq_cst) != 0) {
+        epoch_.notify_one();
+    }
+}
+
+inline void EventCount::notify_all()
+{
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (parked_.load(std::memory_order_seq_cst) != 0) {
+        epoch_.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <functional>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+#include "gendef.h"
+
+namespace gen
+{
+
+struct WatchdogPolicy
+{
+    // a handler call running longer is reported as stuck
+    std::chrono::milliseconds stuck_after = std::chrono::milliseconds(1000);
+    std::chrono::milliseconds interval = std::chrono::milliseconds(20);
+
+    // start a worker in place of each stuck one, which retires
+    // when its call returns; own workers only
+    bool replace_stuck = false;
+
+    // for idempotent handlers of copyable elements: a call running
+    // longer than the hedge_quantile of recent calls is dispatched
+    // once more and the first completion is used
+    bool   hedge = false;
+    double hedge_quantile = 0.99;
+    std::chrono::milliseconds min_hedge_delay = std::chrono::milliseconds(1);
+};
+
+struct StuckCall
+{
+    std::thread::id           thread;
+    std::chrono::milliseconds running;
+};
+
+/// Keeps the latencies of the last WINDOW handler calls
+/// and tells when a running call is stuck or worth hedging
+class Watchdog
+{
+ public:
+    // calls measured before hedging starts
+    static constexpr uint64_t MIN_SAMPLES = 32;
+    static constexpr size_t   WINDOW = 256;
+
+    Watchdog(WatchdogPolicy policy, std::function<void(const StuckCall&)> on_stuck);
+
+    void record(int64_t ns);
+
+    /// Recomputes the hedge delay from the window; called by one
+    /// thread, once per scan
+    void update();
+
+    bool stuck(int64_t running_ns) const;
+    bool should_hedge(int64_t running_ns) const;
+
+    /// 0 until MIN_SAMPLES calls are recorded
+    std::chrono::nanoseconds hedge_delay() const;
+
+    void report(const StuckCall& call) const;
+
+    const WatchdogPolicy& policy() const;
+
+ private:
+    WatchdogPolicy                         policy_;
+    std::function<void(const StuckCall&)> on_stuck_;
+
+    // ring of the latest calls, overwritten oldest first
+    std::array<std::atomic<int64_t>, WINDOW> recent_;
+    std::atomic<uint64_t>                    recorded_;
+    std::atomic<int64_t>                     hedge_delay_;
+    std::vector<int64_t>                     sorted_;  // update() only
+};
+
+inline Watchdog::Watchdog(WatchdogPolicy policy, std::function<void(const StuckCall&)> on_stuck)
+    : policy_(policy),
+      on_stuck_(std::move(on_stuck)),
+      recent_{},
+      recorded_(0),
+      hedge_delay_(0)
+{
+    sorted_.reserve(WINDOW);
+}
+
+inline void Watchdog::record(int64_t ns)
+{
+    uint64_t at = recorded_.fetch_add(1, std::memory_order_relaxed);
+    recent_[at % WINDOW].store(ns, std::memory_order_relaxed);
+}
+
+inline void Watchdog::update()
+{
+    uint64_t recorded = recorded_.load(std::memory_order_relaxed);
+    if (!policy_.hedge || recorded < MIN_SAMPLES) {
+        return;
+    }
+
+    size_t n = static_cast<size_t>(std::min<uint64_t>(recorded, WINDOW));
+    sorted_.clear();
+    for (size_t i = 0; i < n; ++i) {
+        sorted_.push_back(recent_[i].load(std::memory_order_relaxed));
+    }
+
+    double rank = std::ceil(policy_.hedge_quantile * static_cast<double>(n));
+    size_t k = std::min(n - 1, static_cast<size_t>(std::max(rank, 1.0)) - 1);
+    std::nth_element(sorted_.begin(), sorted_.begin() + k, sorted_.end());
+
+    int64_t delay = std::max<int64_t>(
+        sorted_[k],
+        std::chrono::nanoseconds(policy_.min_hedge_delay).count()
+    );
+    hedge_delay_.store(delay, std::memory_order_relaxed);
+}
+
+inline bool Watchdog::stuck(int64_t running_ns) const
+{ return running_ns > std::chrono::nanoseconds(policy_.stuck_after).count(); }
+
+inline bool Watchdog::should_hedge(int64_t running_ns) const
+{
+    int64_t delay = hedge_delay_.load(std::memory_order_relaxed);
+    return policy_.hedge && delay > 0 && running_ns > delay;
+}
+
+inline std::chrono::nanoseconds Watchdog::hedge_delay() const
+{ return std::chrono::nanoseconds(hedge_delay_.load(std::memory_order_relaxed)); }
+
+inline void Watchdog::report(const StuckCall& call) const
+{
+    if (on_stuck_) {
+        on_stuck_(call);
+    }
+}
+
+inline const WatchdogPolicy& Watchdog::policy() const
+{ return policy_; }
+
+}
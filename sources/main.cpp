@@ -1,5 +1,12 @@
-#include "tests.h"
-
-int main() {
-    ::RUN_ALL_TESTS();
+#include "tests.h"
+
+#ifdef __LOCK_PROFILING__
+#include <iostream>
+#endif  // __LOCK_PROFILING__
+
+int main() {
+    ::RUN_ALL_TESTS();
+#ifdef __LOCK_PROFILING__
+    gen::LockProfiler::instance().report(std::cout);
+#endif  // __LOCK_PROFILING__
 }
\ No newline at end of file
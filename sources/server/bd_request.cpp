@@ -1,13 +1,81 @@
-#include "bd_request.h"
-
-namespace server
-{
-
-BDRequest::BDRequest(const char* text, size_t id)
-    : data_(text, id)
-{ }
-
-RData BDRequest::getData() const
-{ return data_; }
-
+#include "bd_request.h"
+
+namespace server
+{
+
+BDRequest::BDRequest(const char* text, size_t id)
+    : data_(text, id),
+      deadline_(deadline_t::max()),
+      verb_(classify_verb(data_.txt.data(), data_.txt.size()))
+{ }
+
+BDRequest::BDRequest(const char* text, size_t id, deadline_t deadline)
+    : data_(text, id),
+      deadline_(deadline),
+      verb_(classify_verb(data_.txt.data(), data_.txt.size()))
+{ }
+
+BDRequest::BDRequest(std::string_view text, size_t id, Verb verb)
+    : data_(text, id),
+      deadline_(deadline_t::max()),
+      verb_(verb)
+{ }
+
+RData BDRequest::getData() const
+{ return data_; }
+
+Verb BDRequest::verb() const
+{ return verb_; }
+
+size_t BDRequest::footprint() const
+{ return data_.txt.capacity(); }
+
+BDRequest::deadline_t BDRequest::deadline() const
+{ return deadline_; }
+
+namespace
+{
+
+// the first n bytes of s as a little-endian word
+constexpr uint64_t word_of(const char* s, size_t n)
+{
+    uint64_t word = 0;
+    for (size_t i = 0; i < n; ++i) {
+        word |= uint64_t(static_cast<uint8_t>(s[i])) << (8 * i);
+    }
+    return word;
+}
+
+constexpr uint64_t mask_of(size_t n)
+{ return (uint64_t(1) << (8 * n)) - 1; }
+
+}
+
+Verb classify_verb(const char* line, size_t length)
+{
+    // every verb fits into one word, so each is a single compare
+    uint64_t word = word_of(line, length < 8 ? length : 8);
+
+    auto is = [&](const char* verb, size_t n) {
+        if (length < n || (word & mask_of(n)) != word_of(verb, n)) {
+            return false;
+        }
+        return length == n || line[n] == ' ' || line[n] == '\t' || line[n] == '\r';
+    };
+
+    switch (static_cast<char>(word)) {
+        case 'G':
+            return is("GET", 3) ? VERB_GET : VERB_UNKNOWN;
+        case 'P':
+            return is("PUT", 3) ? VERB_PUT : is("POST", 4) ? VERB_POST : VERB_UNKNOWN;
+        case 'D':
+            return is("DELETE", 6) ? VERB_DELETE : VERB_UNKNOWN;
+        default:
+            return VERB_UNKNOWN;
+    }
+}
+
+Verb classify(const BDRequest& r)
+{ return r.verb(); }
+
 }
\ No newline at end of file
@@ -1,26 +1,65 @@
-#pragma once
-#include <string>
-
-namespace server
-{
-struct RData
-{
-    std::string txt;
-    size_t id;
-
-    RData(const char* s, size_t i)
-        : txt(s), id(i)
-    { }
-};
-
-class BDRequest
-{
- public:
-    explicit BDRequest(const char* text, size_t id);
-    RData getData() const;
-
- private:
-    RData data_;
-};
-
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <chrono>
+
+namespace server
+{
+enum Verb : uint8_t
+{
+    VERB_GET,
+    VERB_PUT,
+    VERB_POST,
+    VERB_DELETE,
+    VERB_UNKNOWN,
+    N_OF_VERBS
+};
+
+/// Verb of a request line: the word before the first space, tab,
+/// carriage return or the end; VERB_UNKNOWN for anything else
+Verb classify_verb(const char* line, size_t length);
+
+struct RData
+{
+    std::string txt;
+    size_t id;
+
+    RData(const char* s, size_t i)
+        : txt(s), id(i)
+    { }
+
+    RData(std::string_view s, size_t i)
+        : txt(s), id(i)
+    { }
+};
+
+class BDRequest
+{
+ public:
+    using deadline_t = std::chrono::steady_clock::time_point;
+
+    explicit BDRequest(const char* text, size_t id);
+    BDRequest(const char* text, size_t id, deadline_t deadline);
+
+    /// For parsers which have classified text already
+    BDRequest(std::string_view text, size_t id, Verb verb);
+
+    RData getData() const;
+    Verb verb() const;
+
+    /// Heap memory held by the request
+    size_t footprint() const;
+
+    /// When the client stops waiting for the response, max() if never
+    deadline_t deadline() const;
+
+ private:
+    RData      data_;
+    deadline_t deadline_;
+    Verb       verb_;
+};
+
+Verb classify(const BDRequest& r);
+
 }
\ No newline at end of file
@@ -1,53 +1,41 @@
-#include "bd_request_counter.h"
-
-namespace server
-{
-
-void BDRequestCounter::inc(const BDRequest& r)
-{
-    std::string t = r.getData().txt;
-    std::lock_guard<std::mutex> guard(mutex);
-    if (t == "GET") {
-        ++n_get;
-    }
-    else if (t == "PUT") {
-        ++n_put;
-    }
-    else if (t == "POST") {
-        ++n_post;
-    }
-    else if (t == "DELETE") {
-        ++n_delete;
-    }
-    ++total;
-}
-
-void BDRequestCounter::dec(const BDRequest& r)
-{
-    std::string t = r.getData().txt;
-    std::lock_guard<std::mutex> guard(mutex);
-    if (t == "GET") {
-        --n_get;
-    }
-    else if (t == "PUT") {
-        --n_put;
-    }
-    else if (t == "POST") {
-        --n_post;
-    }
-    else if (t == "DELETE") {
-        --n_delete;
-    }
-}
-
-int64_t BDRequestCounter::get_all_ignored() const
-{
-    return n_get + n_put + n_post + n_delete;
-}
-
-int64_t BDRequestCounter::get_all()
-{
-    return total;
-}
-
+#include "bd_request_counter.h"
+
+namespace server
+{
+
+BDRequestCounter::BDRequestCounter()
+    : n_by_verb{},
+      total(0)
+{ }
+
+void BDRequestCounter::inc(const BDRequest& r)
+{
+    Verb verb = r.verb();
+    if (verb != VERB_UNKNOWN) {
+        n_by_verb[verb].fetch_add(1, std::memory_order_relaxed);
+    }
+    total.fetch_add(1, std::memory_order_relaxed);
+}
+
+void BDRequestCounter::dec(const BDRequest& r)
+{
+    Verb verb = r.verb();
+    if (verb != VERB_UNKNOWN) {
+        n_by_verb[verb].fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+int64_t BDRequestCounter::get(Verb verb) const
+{ return verb < VERB_UNKNOWN ? n_by_verb[verb].load(std::memory_order_relaxed) : 0; }
+
+int64_t BDRequestCounter::get_all_ignored() const
+{
+    return n_by_verb[VERB_GET] + n_by_verb[VERB_PUT] + n_by_verb[VERB_POST] + n_by_verb[VERB_DELETE];
+}
+
+int64_t BDRequestCounter::get_all()
+{
+    return total;
+}
+
 }
\ No newline at end of file
@@ -1,30 +1,29 @@
-#pragma once
-
-#include <atomic>
-#include <mutex>
-#include "bd_request.h"
-
-namespace server
-{
-
-class BDRequestCounter
-{
- public:
-    BDRequestCounter() = default;
-    void inc(const BDRequest& r);
-    void dec(const BDRequest& r);
-
-    int64_t get_all();
-    int64_t get_all_ignored() const;
-
- private:
-    int64_t n_get;
-    int64_t n_put;
-    int64_t n_post;
-    int64_t n_delete;
-    int64_t total;
-    
-    std::mutex mutex;
-};
-
+#pragma once
+
+#include <atomic>
+#include "bd_request.h"
+
+namespace server
+{
+
+class BDRequestCounter
+{
+ public:
+    BDRequestCounter();
+    void inc(const BDRequest& r);
+    void dec(const BDRequest& r);
+
+    int64_t get_all();
+    int64_t get_all_ignored() const;
+
+    /// Pending requests of verb
+    int64_t get(Verb verb) const;
+
+ private:
+    // pending requests by verb, the unknown ones are not counted;
+    // atomic, so metrics can be read while requests are counted
+    std::atomic<int64_t> n_by_verb[N_OF_VERBS];
+    std::atomic<int64_t> total;
+};
+
 }
\ No newline at end of file
@@ -1,16 +1,29 @@
-#include "bd_request_handler.h"
-
-namespace server
-{
-
-BDRequestHandler::BDRequestHandler(BDRequestCounter& c)
-    : counter_(c)
-{ }
-
-void BDRequestHandler::process(BDRequest&& request)
-{
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    counter_.dec(request);
-}
-
+#include "bd_request_handler.h"
+
+namespace server
+{
+
+BDRequestHandler::BDRequestHandler(BDRequestCounter& c)
+    : counter_(c)
+{ }
+
+BDResponse BDRequestHandler::process(BDRequest&& request)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    counter_.dec(request);
+    return request.getData();
+}
+
+BDResponse BDRequestHandler::process(BDRequest&& request, std::stop_token token)
+{
+    for (int i = 0; i < 50; ++i) {
+        if (token.stop_requested()) {
+            throw gen::OperationCancelled();
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    counter_.dec(request);
+    return request.getData();
+}
+
 }
\ No newline at end of file
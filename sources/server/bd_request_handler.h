@@ -1,24 +1,25 @@
-#pragma once
-
-#include "handler.h"
-#include "bd_request.h"
-#include "bd_request_counter.h"
-
-namespace server
-{
-
-using BDResponse = RData;
-
-class BDRequestHandler : public gen::DataHandler<BDRequest>
-{
- public:
-    explicit BDRequestHandler(BDRequestCounter& c);
-
- private:
-    void process(BDRequest&& data) override;
-
- private:
-    BDRequestCounter& counter_;
-};
-
+#pragma once
+
+#include "handler.h"
+#include "bd_request.h"
+#include "bd_request_counter.h"
+
+namespace server
+{
+
+using BDResponse = RData;
+
+class BDRequestHandler : public gen::DataHandler<BDRequest, BDResponse>
+{
+ public:
+    explicit BDRequestHandler(BDRequestCounter& c);
+
+ private:
+    BDResponse process(BDRequest&& data) override;
+    BDResponse process(BDRequest&& data, std::stop_token token) override;
+
+ private:
+    BDRequestCounter& counter_;
+};
+
 }
\ No newline at end of file
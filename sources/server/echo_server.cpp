@@ -1,47 +1,105 @@
-#include "echo_server.h"
-
-namespace server
-{
-
-EchoServer::EchoServer(BDRequestCounter& counter)
-    : generator_(counter),
-      request_handler_(counter),
-      requests_manager_(
-          generator_,
-          request_handler_,
-          1024,
-          16
-      ),
-      backup_(1024)
-{ }
-
-void EchoServer::start()
-{ requests_manager_.start(); }
-
-void EchoServer::stop()
-{ requests_manager_.stop(); }
-
-void EchoServer::restart()
-{
-    requests_manager_.save_session_data(backup_);
-    requests_manager_.restore_session_data(backup_);
-
-    start();
-}
-
-void EchoServer::shutdown()
-{
-    requests_manager_.stop();
-    requests_manager_.save_session_data(backup_);
-}
-
-EchoServer& GetEchoServer(BDRequestCounter& c)
-{
-    static EchoServer server(c);
-    return server;
-}
-
-int64_t EchoServer::get_backup_size()
-{ return backup_.size(); }
-
-}
+#include "echo_server.h"
+
+namespace server
+{
+
+EchoServer::EchoServer(BDRequestCounter& counter)
+    : counter_(counter),
+      generator_(counter),
+      request_handler_(counter),
+      backup_(1024),
+      requests_manager_(
+          generator_,
+          request_handler_,
+          1024,
+          16
+      )
+{ requests_manager_.enable_autoscaling(gen::AutoscalePolicy{4, 16}); }
+
+void EchoServer::start()
+{ requests_manager_.start(); }
+
+void EchoServer::stop()
+{ requests_manager_.stop(); }
+
+void EchoServer::restart()
+{
+    requests_manager_.save_session_data(backup_);
+    requests_manager_.restore_session_data(backup_);
+
+    start();
+}
+
+void EchoServer::shutdown()
+{
+    requests_manager_.stop();
+    requests_manager_.save_session_data(backup_);
+}
+
+void EchoServer::shutdown(std::chrono::milliseconds deadline)
+{
+    requests_manager_.stop(gen::STOP_DRAIN_DEADLINE, deadline);
+    requests_manager_.save_session_data(backup_);
+}
+
+EchoServer& GetEchoServer(BDRequestCounter& c)
+{
+    static EchoServer server(c);
+    return server;
+}
+
+int64_t EchoServer::get_backup_size()
+{ return backup_.size(); }
+
+int64_t EchoServer::get_backup_bytes()
+{ return requests_manager_.stats().backup_bytes; }
+
+int64_t EchoServer::get_expired()
+{ return requests_manager_.stats().expired; }
+
+gen::Completion<BDResponse> EchoServer::submit(BDRequest request)
+{
+    counter_.inc(request);
+    return requests_manager_.submit(std::move(request));
+}
+
+void EchoServer::limit_rate(
+    std::shared_ptr<gen::RateLimiter<BDRequest>> limiter,
+    gen::OverLimit action
+)
+{
+    requests_manager_.limit_rate(
+        std::move(limiter),
+        gen::LIMIT_AT_DISPATCH,
+        action,
+        [this](BDRequest&& r) { backup_.emplace(std::move(r)); }
+    );
+}
+
+void EchoServer::serve_by_deadline()
+{ requests_manager_.enable_deadlines([](const BDRequest& r) { return r.deadline(); }); }
+
+void EchoServer::export_metrics(gen::MetricsExporter& exporter)
+{
+    requests_manager_.enable_latency_histogram();
+    exporter.add(gen::manager_metrics(requests_manager_, "echo"));
+
+    exporter.add([this](gen::MetricsWriter& out) {
+        const char* verbs[] = {"GET", "PUT", "POST", "DELETE"};
+        for (int v = VERB_GET; v < VERB_UNKNOWN; ++v) {
+            out.gauge(
+                "echo_pending_requests",
+                "Generated requests not handled yet",
+                static_cast<double>(counter_.get(static_cast<Verb>(v))),
+                std::string("verb=\"") + verbs[v] + "\""
+            );
+        }
+        out.counter(
+            "echo_requests_total",
+            "Requests generated or submitted",
+            static_cast<double>(counter_.get_all())
+        );
+    });
+}
+
+}
\ No newline at end of file
@@ -1,37 +1,67 @@
-#pragma once
-
-#include "queue.h"
-#include "manager.h"
-
-#include "bd_request.h"
-#include "bd_request_handler.h"
-#include "bd_request_generator.h"
-
-namespace server
-{
-
-class EchoServer
-{
- public:
-    void start();
-    void stop();
-    void restart();
-    void shutdown();
-
-    int64_t get_backup_size();
-
-    friend EchoServer& GetEchoServer(BDRequestCounter& c);
-
- private:
-    BDRequestGenerator generator_;
-    BDRequestHandler request_handler_;
-    gen::ResourceManager<BDRequest> requests_manager_;
-
-    gen::Queue<BDRequest> backup_;
-
-    explicit EchoServer(BDRequestCounter& counter);
-};
-
-EchoServer& GetEchoServer(BDRequestCounter& c);
-
+#pragma once
+
+#include "queue.h"
+#include "manager.h"
+#include "metrics.h"
+
+#include "bd_request.h"
+#include "bd_request_handler.h"
+#include "bd_request_generator.h"
+
+namespace server
+{
+
+class EchoServer
+{
+ public:
+    void start();
+    void stop();
+    void restart();
+    void shutdown();
+
+    /// Drains pending requests for at most deadline, then cancels
+    /// requests in flight and saves everything unprocessed
+    void shutdown(std::chrono::milliseconds deadline);
+
+    int64_t get_backup_size();
+    int64_t get_backup_bytes();
+    int64_t get_expired();
+
+    /// Queues a request bypassing the generator, the handle
+    /// receives the response; must not outlive the server
+    gen::Completion<BDResponse> submit(BDRequest request);
+
+    /// Limits requests before they are handled, limiter may
+    /// classify them by verb; must be called while stopped
+    void limit_rate(
+        std::shared_ptr<gen::RateLimiter<BDRequest>> limiter,
+        gen::OverLimit action
+    );
+
+    /// Handles the requests with the earliest deadline first and
+    /// drops expired ones unanswered; must be called while stopped
+    void serve_by_deadline();
+
+    /// Adds the manager's stats with request latencies, pending
+    /// requests by verb and the backup to exporter, which must be
+    /// stopped before the server is gone; must be called while stopped
+    void export_metrics(gen::MetricsExporter& exporter);
+
+    friend EchoServer& GetEchoServer(BDRequestCounter& c);
+
+ private:
+    BDRequestCounter& counter_;
+    BDRequestGenerator generator_;
+    BDRequestHandler request_handler_;
+
+    // outlives the manager, which may save to it until destroyed
+    gen::Queue<BDRequest> backup_;
+
+    gen::ResourceManager<BDRequest, BDResponse> requests_manager_;
+
+    explicit EchoServer(BDRequestCounter& counter);
+};
+
+EchoServer& GetEchoServer(BDRequestCounter& c);
+
 }
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "request_parser.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REQUEST_PARSER_X86
+#endif
+
+namespace server
+{
+
+namespace
+{
+
+void scan_scalar(const char* p, size_t n, size_t from, std::vector<size_t>& ends)
+{
+    for (size_t i = from; i < n; ++i) {
+        if (p[i] == '\n') {
+            ends.push_back(i);
+        }
+    }
+}
+
+void scan_scalar(const char* p, size_t n, std::vector<size_t>& ends)
+{ scan_scalar(p, n, 0, ends); }
+
+#ifdef REQUEST_PARSER_X86
+
+__attribute__((target("sse2")))
+void scan_sse2(const char* p, size_t n, std::vector<size_t>& ends)
+{
+    const __m128i nl = _mm_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, nl)));
+        for (; mask; mask &= mask - 1) {
+            ends.push_back(i + static_cast<size_t>(__builtin_ctz(mask)));
+        }
+    }
+    scan_scalar(p, n, i, ends);
+}
+
+__attribute__((target("avx2")))
+void scan_avx2(const char* p, size_t n, std::vector<size_t>& ends)
+{
+    const __m256i nl = _mm256_set1_epi8('\n');
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl)));
+        for (; mask; mask &= mask - 1) {
+            ends.push_back(i + static_cast<size_t>(__builtin_ctz(mask)));
+        }
+    }
+    scan_scalar(p, n, i, ends);
+}
+
+#endif  // REQUEST_PARSER_X86
+
+}
+
+RequestParser::RequestParser(size_t first_id)
+    : next_id_(first_id),
+      scan_(scan_scalar),
+      isa_("scalar")
+{
+#ifdef REQUEST_PARSER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_ = scan_avx2;
+        isa_ = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        scan_ = scan_sse2;
+        isa_ = "sse2";
+    }
+#endif  // REQUEST_PARSER_X86
+}
+
+size_t RequestParser::parse(std::string_view buffer, std::vector<BDRequest>& out)
+{
+    ends_.clear();
+    scan_(buffer.data(), buffer.size(), ends_);
+
+    verbs_.resize(ends_.size());
+    size_t begin = 0;
+    for (size_t i = 0; i < ends_.size(); ++i) {
+        verbs_[i] = classify_verb(buffer.data() + begin, ends_[i] - begin);
+        begin = ends_[i] + 1;
+    }
+
+    out.reserve(out.size() + ends_.size());
+    begin = 0;
+    for (size_t i = 0; i < ends_.size(); ++i) {
+        size_t end = ends_[i];
+        if (end > begin && buffer[end - 1] == '\r') {
+            --end;
+        }
+        if (end > begin) {
+            out.emplace_back(buffer.substr(begin, end - begin), next_id_++, verbs_[i]);
+        }
+        begin = ends_[i] + 1;
+    }
+    return begin;
+}
+
+const char* RequestParser::isa() const
+{ return isa_; }
+
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "bd_request.h"
+
+namespace server
+{
+
+/// Splits buffers of newline-delimited request lines into BDRequests.
+/// Newlines are found 32 or 16 bytes at a time with AVX2 or SSE2,
+/// whichever the CPU has, then the verbs of all lines are classified
+/// in one pass, and requests are built from views of the buffer
+class RequestParser
+{
+ public:
+    explicit RequestParser(size_t first_id = 1);
+
+    /// Appends a request per complete line of buffer to out, numbered
+    /// in order; a trailing '\r' is dropped and empty lines skipped.
+    /// Returns the bytes consumed, a partial last line is left for
+    /// the next call
+    size_t parse(std::string_view buffer, std::vector<BDRequest>& out);
+
+    /// Name of the newline scan in use: "avx2", "sse2" or "scalar"
+    const char* isa() const;
+
+ private:
+    using scan_t = void (*)(const char*, size_t, std::vector<size_t>&);
+
+    size_t              next_id_;
+    scan_t              scan_;
+    const char*         isa_;
+    std::vector<size_t> ends_;
+    std::vector<Verb>   verbs_;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <iostream>
+
+#include "resource.h"
+#include "handler.h"
+#include "tuning.h"
+
+using namespace gen;
+
+struct EndlessResource final : Resource<int64_t>
+{
+    int64_t next = 0;
+
+    int64_t get_data() override
+    { return next++; }
+
+    bool is_empty() override
+    { return false; }
+};
+
+// a request costs 20us of CPU and waits 500us for I/O
+struct MixedHandler final : DataHandler<int64_t, int64_t>
+{
+    int64_t process(int64_t&& x) override
+    {
+        auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(20);
+        while (std::chrono::steady_clock::now() < until) { }
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        return x;
+    }
+};
+
+void bench_tuning()
+{
+    std::cout << "[INFO] TuningBench is running..." << std::endl;
+
+    TuningSpace space;
+    space.n_of_threads = {2, 4, 8, 16, 32};
+    space.queue_sizes = {64, 1024};
+    space.max_batches = {1, 16};
+
+    TuningOptions options;
+    options.elements = 5000;
+    options.max_trial = std::chrono::milliseconds(1000);
+    options.p99_target = std::chrono::milliseconds(50);
+
+    Tuner<Resource<int64_t>, DataHandler<int64_t, int64_t>> tuner(
+        [] { return std::make_unique<EndlessResource>(); },
+        [] { return std::make_unique<MixedHandler>(); },
+        options
+    );
+    tuner.run(space).write(std::cout);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <ctime>
+#include <vector>
+
+#include "manager.h"
+
+using namespace gen;
+
+struct IdleResource
+{
+    // keeps the receiver from polling at full speed,
+    // so the CPU cost below is the workers' one
+    int64_t get_data()
+    { return 0; }
+
+    bool is_empty()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return true;
+    }
+};
+
+struct LatencyHandler
+{
+    std::vector<int64_t> latencies;
+    std::atomic_size_t   n{0};
+
+    explicit LatencyHandler(size_t capacity)
+        : latencies(capacity)
+    { }
+
+    void process(int64_t&& sent)
+    {
+        int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+        size_t i = n++;
+        if (i < latencies.size()) {
+            latencies[i] = now - sent;
+        }
+    }
+};
+
+void bench_wakeup_case(
+    const char* name,
+    WaitStrategy strategy,
+    SpinPolicy policy,
+    std::chrono::microseconds gap
+)
+{
+    constexpr size_t N_OF_ITEMS = 5000;
+
+    IdleResource   resource;
+    LatencyHandler handler(N_OF_ITEMS);
+
+    BasicResourceManager<IdleResource, LatencyHandler> x(resource, handler, 1024, 5);
+    x.set_wait_strategy(strategy, policy);
+    x.start();
+
+    std::clock_t cpu_begin = std::clock();
+    auto begin = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < N_OF_ITEMS; ++i) {
+        auto next = std::chrono::steady_clock::now() + gap;
+        x.submit(std::chrono::steady_clock::now().time_since_epoch().count());
+        std::this_thread::sleep_until(next);
+    }
+    while (handler.n < N_OF_ITEMS) {
+        std::this_thread::yield();
+    }
+
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    double cpu = static_cast<double>(std::clock() - cpu_begin) / CLOCKS_PER_SEC;
+    x.stop();
+
+    std::sort(handler.latencies.begin(), handler.latencies.end());
+    std::cout << std::setw(16) << name
+              << std::setw(8) << gap.count() << "us"
+              << std::setw(10) << handler.latencies[N_OF_ITEMS / 2] / 1000 << "us"
+              << std::setw(10) << handler.latencies[N_OF_ITEMS * 99 / 100] / 1000 << "us"
+              << std::setw(10) << std::fixed << std::setprecision(2)
+              << cpu / wall << std::endl;
+}
+
+void bench_wakeup()
+{
+    std::cout << "[INFO] WakeupBench is running..." << std::endl;
+    std::cout << std::setw(16) << "strategy"
+              << std::setw(10) << "gap"
+              << std::setw(12) << "p50"
+              << std::setw(12) << "p99"
+              << std::setw(10) << "cores" << std::endl;
+
+    for (auto gap : {std::chrono::microseconds(20), std::chrono::microseconds(200)}) {
+        bench_wakeup_case("block", WAIT_BLOCK, SpinPolicy(), gap);
+        bench_wakeup_case("spin-park", WAIT_SPIN_PARK, SpinPolicy(), gap);
+        bench_wakeup_case("long spin", WAIT_SPIN_PARK, SpinPolicy{200000, 64}, gap);
+    }
+}
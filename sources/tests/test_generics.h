@@ -1,107 +1,1689 @@
-#pragma once
-
-#include <vector>
-#include <iostream>
-#include <chrono>
-
-#include "progress_bar.h"
-#include "manager.h"
-
-using namespace gen;
-
-class ResourceImpl
-    : public Resource<int>
-{
- public:
-    static constexpr size_t CAP = 42;
-
-    ResourceImpl()
-        : v(CAP, 42)
-    { }
-
-    ~ResourceImpl() override
-    { v.clear(); }
-
-    int get_first()
-    {
-        int x = v.back();
-        v.pop_back();
-        return x;
-    }
-
-    int get_data() override
-    { return get_first(); }
-
-    bool is_empty() override
-    { return v.empty(); }
-
- private:
-    std::vector<int> v;
-};
-
-class HandlerImpl
-    : public DataHandler<int>
-{
- public:
-    std::atomic_int popped;
-
-    explicit HandlerImpl(ProgressBar& bar)
-        : popped(0), bar_(bar)
-    { }
-
-    void process(int&& x) override
-    {
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));
-
-        (--x)++;
-        ++popped;
-
-        std::lock_guard<std::mutex> guard(stream_mtx);
-        bar_.make_progress();
-        bar_.update();
-    }
-
- private:
-    ProgressBar& bar_;
-    std::mutex  stream_mtx;
-};
-
-void test_correct_multithreading(size_t n_of_threads)
-{
-    ProgressBar bar(42);
-
-    ResourceImpl container;
-    HandlerImpl  handler(bar);
-
-    ResourceManager<int> x(
-        container,
-        handler,
-        64,
-        n_of_threads
-    );
-
-    std::cout << "[+] Testing with " << n_of_threads << " threads:\n";
-
-    bar.update();
-
-    x.start();
-
-    while (handler.popped < 42);
-
-    x.stop();
-
-    std::cout << std::endl;
-}
-
-void test_generics()
-{
-    std::cout << "[INFO] GenericsTest is running..." << std::endl;
-
-    test_correct_multithreading(4);
-    test_correct_multithreading(8);
-    test_correct_multithreading(16);
-    test_correct_multithreading(32);
-    test_correct_multithreading(43);
-
-    std::cout << std::endl;
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <thread>
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cassert>
+#include <filesystem>
+
+#include <unistd.h>
+
+#include "progress_bar.h"
+#include "manager.h"
+#include "lock_profiler.h"
+#include "payload.h"
+#include "metrics.h"
+#include "tuning.h"
+
+using namespace gen;
+
+class ResourceImpl
+    : public Resource<int>
+{
+ public:
+    static constexpr size_t CAP = 42;
+
+    ResourceImpl()
+        : v(CAP, 42)
+    { }
+
+    ~ResourceImpl() override
+    { v.clear(); }
+
+    int get_first()
+    {
+        int x = v.back();
+        v.pop_back();
+        return x;
+    }
+
+    int get_data() override
+    { return get_first(); }
+
+    bool is_empty() override
+    { return v.empty(); }
+
+ private:
+    std::vector<int> v;
+};
+
+class HandlerImpl
+    : public DataHandler<int>
+{
+ public:
+    std::atomic_int popped;
+
+    explicit HandlerImpl(ProgressBar& bar)
+        : popped(0), bar_(bar)
+    { }
+
+    void process(int&& x) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+        (--x)++;
+        ++popped;
+
+        std::lock_guard<std::mutex> guard(stream_mtx);
+        bar_.make_progress();
+        bar_.update();
+    }
+
+ private:
+    ProgressBar& bar_;
+    std::mutex  stream_mtx;
+};
+
+void test_correct_multithreading(size_t n_of_threads)
+{
+    ProgressBar bar(42);
+
+    ResourceImpl container;
+    HandlerImpl  handler(bar);
+
+    ResourceManager<int> x(
+        container,
+        handler,
+        64,
+        n_of_threads
+    );
+
+    std::cout << "[+] Testing with " << n_of_threads << " threads:\n";
+
+    bar.update();
+
+    x.start();
+
+    while (handler.popped < 42);
+
+    x.stop();
+
+    std::cout << std::endl;
+}
+
+struct StaticResource
+{
+    std::atomic_int left{1000};
+
+    int get_data()
+    { return left--; }
+
+    bool is_empty()
+    { return left <= 0; }
+};
+
+struct StaticHandler
+{
+    std::atomic_long sum{0};
+    std::atomic_int  popped{0};
+
+    void process(int&& x)
+    {
+        sum += x;
+        ++popped;
+    }
+};
+
+void test_static_dispatch(size_t n_of_threads)
+{
+    StaticResource container;
+    StaticHandler  handler;
+
+    BasicResourceManager<StaticResource, StaticHandler> x(
+        container,
+        handler,
+        16,
+        n_of_threads
+    );
+
+    std::cout << "[+] Testing static dispatch with "
+              << n_of_threads << " threads" << std::endl;
+
+    x.start();
+
+    while (handler.popped < 1000);
+
+    x.stop();
+
+    assert(handler.sum == 1000 * 1001 / 2);
+    assert(x.stats().processed == 1000);
+}
+
+struct SlowStaticHandler
+{
+    std::atomic_int popped{0};
+
+    void process(int&&)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        ++popped;
+    }
+};
+
+void test_coalescing()
+{
+    StaticResource    container;
+    SlowStaticHandler handler;
+    std::atomic_int   merged{0};
+
+    BasicResourceManager<StaticResource, SlowStaticHandler> x(
+        container,
+        handler,
+        64,
+        3
+    );
+    x.enable_coalescing(
+        [](const int& v) { return v % 4; },
+        [&](int&&) { ++merged; }
+    );
+
+    std::cout << "[+] Testing coalescing" << std::endl;
+
+    x.start();
+
+    while (handler.popped + merged < 1000);
+
+    x.stop();
+
+    assert(merged > 0);
+    assert(x.stats().coalesced == static_cast<uint64_t>(merged));
+}
+
+struct SquareHandler
+{
+    long process(int&& x)
+    { return long(x) * x; }
+};
+
+void test_submit()
+{
+    StaticResource container;
+    SquareHandler  handler;
+    container.left = 0;
+
+    BasicResourceManager<StaticResource, SquareHandler> x(
+        container,
+        handler,
+        8,
+        4
+    );
+
+    std::cout << "[+] Testing submit" << std::endl;
+
+    x.start();
+
+    std::vector<Completion<long>> handles;
+    for (int i = 0; i < 100; ++i) {
+        handles.push_back(x.submit(i));
+    }
+
+    std::atomic_int called{0};
+    Completion<long> last = x.submit(7);
+    last.then([&](long* r) { assert(r && *r == 49); ++called; });
+
+    for (int i = 0; i < 100; ++i) {
+        assert(handles[i].get() == long(i) * i);
+        assert(handles[i].ready() && !handles[i].dropped());
+    }
+    last.wait();
+    while (called == 0);
+
+    x.stop();
+
+    Completion<long> pending = x.submit(3);
+    Queue<int> backup(8);
+    x.save_session_data(backup);
+    assert(pending.ready() && pending.dropped());
+    assert(backup.size() == 1);
+    backup.clear();
+}
+
+struct CancellableHandler
+{
+    std::atomic_int popped{0};
+
+    void process(int&& x)
+    { process(std::move(x), std::stop_token()); }
+
+    void process(int&&, std::stop_token token)
+    {
+        for (int i = 0; i < 100; ++i) {
+            if (token.stop_requested()) {
+                throw OperationCancelled();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        ++popped;
+    }
+};
+
+// ignores cancellation for a while, then gives the element up
+struct StubbornHandler
+{
+    std::atomic_int calls{0};
+
+    void process(int&& x)
+    { process(std::move(x), std::stop_token()); }
+
+    void process(int&&, std::stop_token token)
+    {
+        ++calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if (token.stop_requested()) {
+            throw OperationCancelled();
+        }
+    }
+};
+
+void test_stop_modes()
+{
+    using clock = std::chrono::steady_clock;
+
+    std::cout << "[+] Testing stop modes" << std::endl;
+
+    {
+        StaticResource     container;
+        CancellableHandler handler;
+        container.left = 0;
+
+        BasicResourceManager<StaticResource, CancellableHandler> x(
+            container, handler, 64, 5
+        );
+        for (int i = 0; i < 40; ++i) {
+            x.submit(i);
+        }
+        x.start();
+
+        auto begin = clock::now();
+        x.stop(STOP_DRAIN_DEADLINE, std::chrono::milliseconds(150));
+        assert(clock::now() - begin < std::chrono::milliseconds(400));
+
+        Queue<int> backup(64);
+        x.save_session_data(backup);
+        assert(handler.popped + backup.size() == 40);
+        assert(x.stats().requeued > 0);
+        backup.clear();
+    }
+
+    {
+        StaticResource     container;
+        CancellableHandler handler;
+        container.left = 0;
+
+        BasicResourceManager<StaticResource, CancellableHandler> x(
+            container, handler, 64, 5
+        );
+        for (int i = 0; i < 12; ++i) {
+            x.submit(i);
+        }
+        x.start();
+        x.stop(STOP_DRAIN);
+        assert(handler.popped == 12);
+    }
+
+    // a straggler gives its element up after the session is saved
+    {
+        StaticResource  container;
+        StubbornHandler handler;
+        Queue<int>      backup(8);
+        container.left = 0;
+
+        BasicResourceManager<StaticResource, StubbornHandler> x(container, handler, 64, 2);
+        for (int i = 0; i < 3; ++i) {
+            x.submit(i);
+        }
+        x.start();
+        while (handler.calls == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        x.stop(STOP_IMMEDIATE, std::chrono::milliseconds(0), std::chrono::milliseconds(10));
+
+        x.save_session_data(backup);
+        assert(backup.size() == 2);
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        assert(backup.size() == 3 && x.stats().backup == 3);
+        assert(x.stats().pending == 0);
+    }
+}
+
+struct OrderedHandler
+{
+    std::atomic_int popped{0};
+    std::atomic_int in_flight[8]{};
+    std::atomic_int last[8]{};
+    std::atomic_int violations{0};
+
+    void process(int&& x)
+    {
+        int key = x & 7;
+        if (in_flight[key]++ != 0 || (last[key] != 0 && last[key] < x)) {
+            ++violations;
+        }
+        last[key] = x;
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        --in_flight[key];
+        ++popped;
+    }
+};
+
+void test_partitioning()
+{
+    StaticResource container;
+    OrderedHandler handler;
+
+    BasicResourceManager<StaticResource, OrderedHandler> x(
+        container,
+        handler,
+        64,
+        6
+    );
+    x.enable_partitioning([](const int& v) { return v & 7; }, 8);
+
+    std::cout << "[+] Testing partitioning" << std::endl;
+
+    x.start();
+
+    while (handler.popped < 1000);
+
+    x.stop();
+
+    assert(handler.violations == 0);
+}
+
+struct Job
+{
+    int                                   id;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+struct NoJobs
+{
+    Job get_data()
+    { return Job{}; }
+
+    bool is_empty()
+    { return true; }
+};
+
+struct JobLog
+{
+    std::atomic_bool open{false};
+    std::mutex       mutex;
+    std::vector<int> order;
+
+    void process(Job&& job)
+    {
+        while (!open) {
+            std::this_thread::yield();
+        }
+        std::lock_guard<std::mutex> guard(mutex);
+        order.push_back(job.id);
+    }
+};
+
+void test_deadlines()
+{
+    using namespace std::chrono_literals;
+
+    NoJobs container;
+    JobLog handler;
+
+    BasicResourceManager<NoJobs, JobLog> x(container, handler, 64, 2);
+    x.enable_deadlines([](const Job& job) { return job.deadline; });
+
+    std::cout << "[+] Testing deadline scheduling" << std::endl;
+
+    x.start();
+
+    auto now = std::chrono::steady_clock::now();
+    auto first = x.submit(Job{0, now + 10s});
+    while (x.stats().pending != 0) {
+        std::this_thread::yield();
+    }
+
+    // the only worker is busy with job 0 while these wait
+    x.submit(Job{3, now + 30s});
+    x.submit(Job{1, now + 10s});
+    auto expired = x.submit(Job{9, now - 1ms});
+    x.submit(Job{2, now + 20s});
+    x.submit(Job{4, now + 30s});
+
+    handler.open = true;
+    x.stop(STOP_DRAIN);
+
+    assert(first.ready() && !first.dropped());
+    assert(expired.dropped());
+    assert(x.stats().expired == 1);
+    assert((handler.order == std::vector<int>{0, 1, 2, 3, 4}));
+}
+
+struct NoInts
+{
+    int get_data()
+    { return 0; }
+
+    bool is_empty()
+    { return true; }
+};
+
+// calls for 0 hang until released, the first call for 42 too
+struct HangingHandler
+{
+    std::atomic_bool released{false};
+    std::atomic_bool first{true};
+    std::atomic_int  calls{0};
+
+    int process(int&& x)
+    {
+        ++calls;
+        if (x == 0 || (x == 42 && first.exchange(false))) {
+            while (!released) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        return 2 * x;
+    }
+};
+
+// calls for 0 run until cancelled
+struct CancelledZeroHandler
+{
+    std::atomic_int calls{0};
+
+    void process(int&& x)
+    { process(std::move(x), std::stop_token()); }
+
+    void process(int&& x, std::stop_token token)
+    {
+        ++calls;
+        while (x == 0) {
+            if (token.stop_requested()) {
+                throw OperationCancelled();
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+};
+
+void test_watchdog()
+{
+    using namespace std::chrono_literals;
+
+    std::cout << "[+] Testing watchdog" << std::endl;
+
+    {
+        WatchdogPolicy policy;
+        policy.hedge = true;
+        policy.hedge_quantile = 0.5;
+        Watchdog watchdog(policy, nullptr);
+
+        for (int i = 1; i <= 100; ++i) {
+            watchdog.record(i * 30000);
+        }
+        watchdog.update();
+        assert(watchdog.hedge_delay() == 1500us);
+
+        // the delay follows the latest calls only
+        for (size_t i = 0; i < Watchdog::WINDOW; ++i) {
+            watchdog.record(5000000);
+        }
+        watchdog.update();
+        assert(watchdog.hedge_delay() == 5ms);
+        assert(!watchdog.should_hedge(4000000) && watchdog.should_hedge(6000000));
+    }
+
+    {
+        NoInts         container;
+        HangingHandler handler;
+        std::atomic_int reported{0};
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 64, 2);
+        x.enable_watchdog(
+            WatchdogPolicy{50ms, 5ms, true},
+            [&](const StuckCall& call) {
+                assert(call.running >= 50ms);
+                ++reported;
+            }
+        );
+        x.start();
+
+        auto stuck = x.submit(0);
+        std::vector<Completion<int>> others;
+        for (int i = 1; i <= 10; ++i) {
+            others.push_back(x.submit(i));
+        }
+
+        // the only worker hangs, its replacement handles the rest
+        for (auto& c : others) {
+            c.wait();
+        }
+        assert(!stuck.ready());
+        assert(reported == 1);
+        assert(x.stats().stuck == 1 && x.stats().replaced == 1);
+
+        handler.released = true;
+        x.stop(STOP_DRAIN);
+        assert(stuck.get() == 0);
+    }
+
+    {
+        NoInts         container;
+        HangingHandler handler;
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 64, 3);
+        WatchdogPolicy policy;
+        policy.interval = 2ms;
+        policy.hedge = true;
+        x.enable_watchdog(policy);
+        x.start();
+
+        for (int i = 1; i <= 40; ++i) {
+            x.submit(i).wait();
+        }
+
+        // the hedged copy answers while the first call hangs
+        auto slow = x.submit(42);
+        assert(slow.get() == 84);
+        assert(x.stats().hedged == 1);
+
+        handler.released = true;
+        x.stop(STOP_DRAIN);
+        assert(handler.calls == 42);
+        assert(x.stats().processed == 41);
+    }
+
+    {
+        NoInts                container;
+        CancelledZeroHandler handler;
+
+        BasicResourceManager<NoInts, CancelledZeroHandler> x(container, handler, 64, 3);
+        WatchdogPolicy policy;
+        policy.interval = 2ms;
+        policy.hedge = true;
+        x.enable_watchdog(policy);
+        x.start();
+
+        for (int i = 1; i <= 40; ++i) {
+            x.submit(i).wait();
+        }
+
+        // the original and its copy are both cancelled, only one is kept
+        x.submit(0);
+        for (int i = 0; i < 1000 && handler.calls < 42; ++i) {
+            std::this_thread::sleep_for(1ms);
+        }
+        assert(x.stats().hedged == 1 && handler.calls == 42);
+        x.stop(STOP_IMMEDIATE);
+        assert(x.stats().pending == 1);
+
+        Queue<int> backup;
+        x.save_session_data(backup);
+        assert(backup.size() == 1 && backup.front() == 0);
+    }
+}
+
+size_t count_files(const std::string& dir)
+{
+    auto files = std::filesystem::directory_iterator(dir);
+    return static_cast<size_t>(std::distance(begin(files), end(files)));
+}
+
+void test_journal()
+{
+    using namespace std::chrono_literals;
+
+    std::cout << "[+] Testing journal" << std::endl;
+
+    std::string dir = "/tmp/gen_journal_" + std::to_string(getpid());
+    JournalOptions options;
+    options.segment_bytes = 1024;
+    options.wait_for_sync = true;
+
+    {
+        NoInts         container;
+        HangingHandler handler;
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 256, 2);
+        x.enable_journal(dir, options);
+        x.start();
+
+        // concurrent submitters share syncs
+        std::vector<std::thread> producers;
+        for (int t = 0; t < 4; ++t) {
+            producers.emplace_back([&x, t] {
+                for (int i = 1; i <= 25; ++i) {
+                    x.submit(100 * t + i);
+                }
+            });
+        }
+        for (auto& p : producers) {
+            p.join();
+        }
+        x.stop(STOP_DRAIN);
+        assert(x.stats().processed == 100);
+        assert(x.stats().synced < 100);
+
+        // queued while stopped and lost with the manager
+        for (int i = 1; i <= 100; ++i) {
+            x.submit(1000 + i);
+        }
+    }
+
+    {
+        NoInts         container;
+        HangingHandler handler;
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 256, 2);
+        x.enable_journal(dir, options);
+        assert(x.stats().replayed == 100);
+        assert(x.stats().pending == 100);
+
+        x.start();
+        x.stop(STOP_DRAIN);
+        assert(x.stats().processed == 100);
+        assert(handler.calls == 100);
+
+        // acked segments are deleted, the one taking appends stays
+        for (int i = 0; i < 200 && count_files(dir) > 1; ++i) {
+            std::this_thread::sleep_for(10ms);
+        }
+        assert(count_files(dir) == 1);
+    }
+
+    {
+        NoInts         container;
+        HangingHandler handler;
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 256, 2);
+        x.enable_journal(dir, options);
+        assert(x.stats().replayed == 0);
+    }
+
+    std::filesystem::remove_all(dir);
+
+    // both copies of a hedged element finish, it is acked once
+    {
+        NoInts         container;
+        HangingHandler handler;
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 64, 3);
+        WatchdogPolicy policy;
+        policy.interval = 2ms;
+        policy.hedge = true;
+        x.enable_watchdog(policy);
+        x.start();
+        for (int i = 1; i <= 40; ++i) {
+            x.submit(i).wait();
+        }
+        x.stop(STOP_DRAIN);
+
+        // two records fill the first segment
+        JournalOptions small;
+        small.segment_bytes = 40;
+        x.enable_journal(dir, small);
+        x.start();
+
+        // the original and its copy hang, 1001 waits behind them
+        x.submit(0);
+        for (int i = 0; i < 1000 && handler.calls < 42; ++i) {
+            std::this_thread::sleep_for(1ms);
+        }
+        assert(x.stats().hedged == 1 && handler.calls == 42);
+        x.submit(1001);
+
+        std::thread stopper([&x] { x.stop(); });
+        std::this_thread::sleep_for(20ms);
+        handler.released = true;
+        stopper.join();
+        assert(x.stats().pending == 1);
+
+        // rolls the segment, which must not be deleted with 1001 in it
+        x.submit(1002);
+        std::this_thread::sleep_for(50ms);
+    }
+
+    {
+        NoInts         container;
+        HangingHandler handler;
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 64, 2);
+        x.enable_journal(dir, options);
+        assert(x.stats().replayed == 2);
+    }
+
+    std::filesystem::remove_all(dir);
+
+    // a failed write is sticky and leaves the records not durable
+    {
+        Journal journal(dir, JournalOptions());
+        std::filesystem::remove_all(dir);
+
+        uint64_t seq = journal.append("lost");
+        bool thrown = false;
+        try {
+            journal.wait_durable(seq);
+        } catch (const std::system_error& e) {
+            thrown = e.code() == std::errc::no_such_file_or_directory;
+        }
+        assert(thrown && journal.error());
+
+        thrown = false;
+        try {
+            journal.append("next");
+        } catch (const std::system_error&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+
+    {
+        NoInts         container;
+        HangingHandler handler;
+
+        BasicResourceManager<NoInts, HangingHandler> x(container, handler, 64, 2);
+        x.enable_journal(dir, options);
+        std::filesystem::remove_all(dir);
+
+        bool thrown = false;
+        try {
+            x.submit(1);
+        } catch (const std::system_error&) {
+            thrown = true;
+        }
+        assert(thrown && x.journal_error());
+        assert(x.stats().pending == 0);
+    }
+}
+
+void test_rate_limiting()
+{
+    using clock = std::chrono::steady_clock;
+
+    std::cout << "[+] Testing rate limiting" << std::endl;
+
+    {
+        TokenBucket bucket(RateLimit{10, 5});
+        for (int i = 0; i < 5; ++i) {
+            assert(bucket.try_acquire());
+        }
+        assert(!bucket.try_acquire());
+    }
+
+    {
+        StaticResource container;
+        StaticHandler  handler;
+        container.left = 0;
+
+        auto limiter = std::make_shared<RateLimiter<int>>();
+        limiter->limit_all(RateLimit{1, 5});
+
+        BasicResourceManager<StaticResource, StaticHandler> x(
+            container, handler, 64, 3
+        );
+        x.limit_rate(limiter, LIMIT_AT_INGESTION, OVER_LIMIT_REJECT);
+        x.start();
+
+        std::vector<Completion<void>> handles;
+        for (int i = 0; i < 20; ++i) {
+            handles.push_back(x.submit(i));
+        }
+        x.stop(STOP_DRAIN);
+
+        assert(handler.popped == 5);
+        assert(x.stats().rejected == 15);
+        assert(handles.back().dropped());
+    }
+
+    {
+        StaticResource container;
+        StaticHandler  handler;
+        container.left = 0;
+
+        auto limiter = std::make_shared<RateLimiter<int>>();
+        limiter->limit_all(RateLimit{200, 1});
+
+        BasicResourceManager<StaticResource, StaticHandler> x(
+            container, handler, 64, 5
+        );
+        x.limit_rate(limiter, LIMIT_AT_DISPATCH, OVER_LIMIT_DELAY);
+        for (int i = 0; i < 20; ++i) {
+            x.submit(i);
+        }
+
+        auto begin = clock::now();
+        x.start();
+        x.stop(STOP_DRAIN);
+
+        assert(clock::now() - begin >= std::chrono::milliseconds(80));
+        assert(handler.popped == 20);
+        assert(x.stats().delayed > 0);
+    }
+
+    {
+        StaticResource container;
+        StaticHandler  handler;
+        container.left = 0;
+
+        auto limiter = std::make_shared<RateLimiter<int>>();
+        limiter->classify([](const int& v) { return v % 2; });
+        limiter->limit_class(0, RateLimit{1, 3});
+
+        std::vector<int> overflow;
+        BasicResourceManager<StaticResource, StaticHandler> x(
+            container, handler, 64, 2
+        );
+        x.limit_rate(
+            limiter,
+            LIMIT_AT_DISPATCH,
+            OVER_LIMIT_OVERFLOW,
+            [&](int&& v) { overflow.push_back(v); }
+        );
+        for (int i = 0; i < 10; ++i) {
+            x.submit(i);
+        }
+        x.start();
+        x.stop(STOP_DRAIN);
+
+        assert(handler.popped == 8);
+        assert(overflow.size() == 2 && overflow[0] % 2 == 0);
+        assert(x.stats().overflowed == 2);
+    }
+}
+
+struct CappedHandler
+{
+    std::atomic_int popped{0};
+    std::atomic_int running{0};
+    std::atomic_int max_running{0};
+
+    void process(int&&)
+    {
+        int now = ++running;
+        int seen = max_running;
+        while (seen < now && !max_running.compare_exchange_weak(seen, now));
+
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+        --running;
+        ++popped;
+    }
+};
+
+void test_shared_executor()
+{
+    using manager_t = BasicResourceManager<StaticResource, CappedHandler>;
+
+    std::cout << "[+] Testing shared executor" << std::endl;
+
+    auto executor = std::make_shared<ThreadPoolExecutor>(4);
+
+    StaticResource first_container;
+    StaticResource second_container;
+    CappedHandler  first_handler;
+    CappedHandler  second_handler;
+
+    manager_t first(first_container, first_handler, 64, 3);
+    manager_t second(second_container, second_handler, 64, 2);
+    first.use_executor(executor);
+    second.use_executor(executor);
+
+    first.start();
+    second.start();
+
+    while (first_handler.popped < 1000 || second_handler.popped < 1000);
+
+    first.stop();
+    second.stop(STOP_DRAIN);
+
+    assert(first_handler.max_running <= 2);
+    assert(second_handler.max_running == 1);
+
+    second_container.left = 0;
+    for (int i = 0; i < 10; ++i) {
+        second.submit(i);
+    }
+    second.start();
+    second.stop(STOP_DRAIN);
+    assert(second.stats().pending == 0);
+}
+
+struct SleepyHandler
+{
+    std::atomic_int popped{0};
+
+    void process(int&&)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++popped;
+    }
+};
+
+void test_autoscaling()
+{
+    StaticResource container;
+    SleepyHandler  handler;
+
+    BasicResourceManager<StaticResource, SleepyHandler> x(
+        container,
+        handler,
+        64,
+        2
+    );
+
+    AutoscalePolicy policy{1, 8};
+    policy.interval = std::chrono::milliseconds(10);
+    policy.up_intervals = 1;
+    policy.down_intervals = 3;
+    x.enable_autoscaling(policy);
+
+    std::cout << "[+] Testing autoscaling" << std::endl;
+
+    x.start();
+
+    while (handler.popped < 1000);
+    assert(x.stats().scale_ups > 0);
+
+    for (int i = 0; i < 200 && x.stats().n_of_threads > 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    assert(x.stats().scale_downs > 0);
+    assert(x.stats().n_of_threads == 2);
+
+    x.stop();
+}
+
+// squares a batch per call, the call costs as much as four elements
+struct BatchSquares
+{
+    std::vector<size_t> sizes;
+
+    int process(int&& x)
+    { return x * x; }
+
+    std::vector<int> process_batch(std::vector<int>&& batch)
+    {
+        sizes.push_back(batch.size());
+        std::this_thread::sleep_for(std::chrono::microseconds(200 + 50 * batch.size()));
+
+        std::vector<int> results;
+        for (int x : batch) {
+            results.push_back(x * x);
+        }
+        return results;
+    }
+};
+
+void test_batching()
+{
+    using namespace std::chrono_literals;
+
+    std::cout << "[+] Testing batching" << std::endl;
+
+    {
+        NoInts       container;
+        BatchSquares handler;
+
+        BasicResourceManager<NoInts, BatchSquares> x(container, handler, 1024, 2);
+        x.enable_batching(BatchPolicy{32, 1000us, 1000ms, 2ms});
+
+        std::vector<Completion<int>> results;
+        for (int i = 0; i < 500; ++i) {
+            results.push_back(x.submit(i));
+        }
+        x.start();
+        x.stop(STOP_DRAIN);
+
+        // the backlog lets batches grow
+        for (int i = 0; i < 500; ++i) {
+            assert(results[i].get() == i * i);
+        }
+        assert(x.stats().processed == 500);
+        assert(x.stats().batches == handler.sizes.size());
+        assert(x.stats().batches < 500);
+        assert(x.stats().batch_size > 1);
+        assert(*std::max_element(handler.sizes.begin(), handler.sizes.end()) > 1);
+    }
+
+    {
+        NoInts        container;
+        SleepyHandler handler;
+
+        BasicResourceManager<NoInts, SleepyHandler> x(container, handler, 1024, 2);
+        x.enable_batching(BatchPolicy{32, 1000us, 5ms, 5ms});
+
+        for (int i = 0; i < 100; ++i) {
+            x.submit(i);
+        }
+        x.start();
+        x.stop(STOP_DRAIN);
+
+        // per element calls, over the latency target batches stay single
+        assert(handler.popped == 100);
+        assert(x.stats().batches == 100);
+        assert(x.stats().batch_size == 1);
+        assert(x.stats().linger_us == 0);
+    }
+}
+
+struct SumHandler
+{
+    std::atomic_int  popped{0};
+    std::atomic_long sum{0};
+
+    void process(int&& x)
+    {
+        sum += x;
+        ++popped;
+    }
+};
+
+void test_producers()
+{
+    using namespace std::chrono_literals;
+
+    std::cout << "[+] Testing producers" << std::endl;
+
+    {
+        NoInts     container;
+        SumHandler handler;
+
+        BasicResourceManager<NoInts, SumHandler> x(container, handler, 64, 4);
+        auto producer = x.make_producer(ProducerPolicy{16, 2ms});
+        x.start();
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&producer] {
+                for (int i = 1; i <= 1000; ++i) {
+                    producer->push(i);
+                }
+            });
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        // the drain starts with a forced flush
+        x.stop(STOP_DRAIN);
+
+        assert(handler.popped == 4000);
+        assert(handler.sum == 4 * 500500);
+        assert(x.stats().received == 4000);
+        assert(producer->flushes() < 4000);
+    }
+
+    {
+        NoInts     container;
+        SumHandler handler;
+
+        BasicResourceManager<NoInts, SumHandler> x(container, handler, 64, 2);
+        auto producer = x.make_producer(ProducerPolicy{64, 1ms});
+        x.start();
+
+        // below max_items, the flusher thread hands them over
+        for (int i = 0; i < 3; ++i) {
+            producer->push(i);
+        }
+        for (int i = 0; i < 1000 && handler.popped < 3; ++i) {
+            std::this_thread::sleep_for(1ms);
+        }
+        assert(handler.popped == 3);
+        x.stop();
+    }
+
+    {
+        NoInts     container;
+        SumHandler handler;
+
+        BasicResourceManager<NoInts, SumHandler> x(container, handler, 64, 2);
+        auto producer = x.make_producer(ProducerPolicy{100, 10s});
+        for (int i = 0; i < 10; ++i) {
+            producer->push(i);
+        }
+
+        Queue<int> backup;
+        x.save_session_data(backup);
+        assert(backup.size() == 10);
+        for (int i = 0; i < 10; ++i) {
+            assert(backup.take_first() == i);
+        }
+        assert(handler.popped == 0);
+    }
+
+    // a producer outliving its manager discards what it flushes later
+    {
+        std::shared_ptr<BufferedProducer<int>> producer;
+        {
+            NoInts     container;
+            SumHandler handler;
+
+            BasicResourceManager<NoInts, SumHandler> x(container, handler, 64, 2);
+            producer = x.make_producer(ProducerPolicy{100, 1ms});
+            x.start();
+            producer->push(1);
+            x.stop(STOP_DRAIN);
+            assert(handler.popped == 1);
+        }
+        producer->push(2);
+        std::this_thread::sleep_for(5ms);
+        producer->push(3);
+        producer.reset();
+    }
+}
+
+void test_tuning()
+{
+    using namespace std::chrono_literals;
+
+    std::cout << "[+] Testing tuning" << std::endl;
+
+    TuningSpace space;
+    space.n_of_threads = {2, 5};
+    space.queue_sizes = {16};
+    space.wait_strategies = {WAIT_BLOCK};
+
+    TuningOptions options;
+    options.elements = 100;
+
+    Tuner<StaticResource, SleepyHandler> tuner(
+        [] { return std::make_unique<StaticResource>(); },
+        [] { return std::make_unique<SleepyHandler>(); },
+        options
+    );
+
+    // sleeping handlers gain from more threads
+    TuningReport report = tuner.run(space);
+    assert(report.trials.size() == 2);
+    for (const auto& trial : report.trials) {
+        assert(trial.processed >= 100 && trial.p99_ms >= 1);
+    }
+    assert(report.trials[1].throughput > report.trials[0].throughput);
+    assert(report.found && report.recommended.n_of_threads == 5);
+
+    std::ostringstream out;
+    report.write(out);
+    assert(out.str().find("recommended: 5 threads, queue 16, block, batch 1") != std::string::npos);
+
+    // a millisecond handler never meets a millisecond p99
+    options.p99_target = 1ms;
+    space.n_of_threads = {5};
+    Tuner<StaticResource, SleepyHandler> strict(
+        [] { return std::make_unique<StaticResource>(); },
+        [] { return std::make_unique<SleepyHandler>(); },
+        options
+    );
+    assert(!strict.run(space).found);
+}
+
+void test_spin_park()
+{
+    StaticResource container;
+    StaticHandler  handler;
+
+    BasicResourceManager<StaticResource, StaticHandler> x(
+        container,
+        handler,
+        16,
+        4
+    );
+    x.set_wait_strategy(WAIT_SPIN_PARK, SpinPolicy{100, 4});
+
+    std::cout << "[+] Testing spin-then-park waiting" << std::endl;
+
+    x.start();
+
+    while (handler.popped < 1000);
+
+    // let the workers park, then wake them up
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    x.submit(1).wait();
+
+    x.stop();
+
+    assert(handler.sum == 1000 * 1001 / 2 + 1);
+}
+
+void test_monitoring()
+{
+    StaticResource    container;
+    SlowStaticHandler handler;
+
+    BasicResourceManager<StaticResource, SlowStaticHandler> x(
+        container,
+        handler,
+        64,
+        2
+    );
+    x.enable_monitoring(
+        [](const int& v) { return v % 3; },
+        [](const int& v) { return v % 5; },
+        MonitorOptions{3}
+    );
+
+    std::cout << "[+] Testing monitoring" << std::endl;
+
+    x.start();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    PendingSnapshot snapshot = x.pending_snapshot(2);
+
+    x.stop();
+
+    assert(snapshot.pending > 0);
+    assert(snapshot.per_class.size() == 3);
+    assert(!snapshot.consistent ||
+           snapshot.per_class[0] + snapshot.per_class[1] + snapshot.per_class[2]
+           == snapshot.pending);
+    assert(snapshot.top_keys.size() == 2);
+    assert(snapshot.top_keys[0].second >= snapshot.top_keys[1].second);
+    assert(snapshot.oldest_age.count() >= 0);
+}
+
+struct NoResource
+{
+    std::string get_data()
+    { return std::string(); }
+
+    bool is_empty()
+    { return true; }
+};
+
+struct GatedHandler
+{
+    std::atomic_bool open{false};
+    std::atomic_int  popped{0};
+
+    void process(std::string&&)
+    {
+        while (!open) {
+            std::this_thread::yield();
+        }
+        ++popped;
+    }
+};
+
+struct StringResource
+{
+    std::atomic_int left{10};
+
+    std::string get_data()
+    {
+        --left;
+        return std::string(300, 'x');
+    }
+
+    bool is_empty()
+    { return left <= 0; }
+};
+
+void test_byte_budget()
+{
+    NoResource   container;
+    GatedHandler handler;
+
+    BasicResourceManager<NoResource, GatedHandler> x(container, handler, 64, 2);
+    x.set_byte_budget(1000);
+
+    std::cout << "[+] Testing byte budget" << std::endl;
+
+    x.start();
+
+    std::thread producer([&] {
+        for (int i = 0; i < 10; ++i) {
+            x.submit(std::string(200, 'x'));
+        }
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    ManagerStats stats = x.stats();
+    assert(stats.pending < 9 && stats.bytes <= 1000);
+
+    handler.open = true;
+    producer.join();
+    x.stop(STOP_DRAIN);
+    assert(handler.popped == 10);
+    assert(x.stats().bytes == 0);
+
+    handler.open = false;
+    x.start();
+    for (int i = 0; i < 3; ++i) {
+        x.submit(std::string(200, 'x'));
+    }
+    handler.open = true;
+    x.stop();
+
+    Queue<std::string> backup(8);
+    x.save_session_data(backup);
+    assert(x.stats().backup_bytes > 0 || backup.empty());
+
+    x.restore_session_data(backup);
+    assert(x.stats().backup_bytes == 0);
+
+    x.start();
+    x.stop(STOP_DRAIN);
+
+    // the receiver waits for room for the element it has fetched
+    StringResource source;
+    GatedHandler   gated;
+
+    BasicResourceManager<StringResource, GatedHandler> y(source, gated, 64, 2);
+    y.set_byte_budget(1000);
+    y.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    assert(y.stats().bytes <= 1000);
+
+    gated.open = true;
+    for (int i = 0; i < 1000 && gated.popped < 10; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    y.stop();
+    assert(gated.popped == 10);
+}
+
+// what curl --unix-socket path http://localhost/metrics gets
+std::string scrape_unix_socket(const std::string& path)
+{
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return "";
+    }
+
+    std::string request = "GET /metrics HTTP/1.0\r\n\r\n";
+    send(fd, request.data(), request.size(), 0);
+
+    std::string response;
+    char block[4096];
+    ssize_t n;
+    while ((n = recv(fd, block, sizeof(block), 0)) > 0) {
+        response.append(block, static_cast<size_t>(n));
+    }
+    close(fd);
+    return response;
+}
+
+size_t count_of(const std::string& text, const std::string& what)
+{
+    size_t n = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + 1)) {
+        ++n;
+    }
+    return n;
+}
+
+void test_metrics()
+{
+    std::cout << "[+] Testing metrics" << std::endl;
+
+    NoInts        container;
+    SquareHandler handler;
+
+    BasicResourceManager<NoInts, SquareHandler> first(container, handler, 64, 2);
+    BasicResourceManager<NoInts, SquareHandler> second(container, handler, 64, 2);
+    first.enable_latency_histogram();
+
+    std::string path = "/tmp/gen_metrics_" + std::to_string(getpid()) + ".sock";
+    MetricsExporter exporter(path);
+    exporter.add(manager_metrics(first, "first"));
+    exporter.add(manager_metrics(second, "second"));
+    exporter.start();
+
+    first.start();
+    for (int i = 0; i < 10; ++i) {
+        first.submit(i).wait();
+    }
+    second.submit(1);
+
+    std::string response = scrape_unix_socket(path);
+    assert(response.rfind("HTTP/1.0 200 OK\r\n", 0) == 0);
+    assert(response.find("gen_processed_total{manager=\"first\"} 10\n") != std::string::npos);
+    assert(response.find("gen_pending{manager=\"second\"} 1\n") != std::string::npos);
+    assert(response.find("gen_latency_seconds_count{manager=\"first\"} 10\n") != std::string::npos);
+    assert(response.find("gen_latency_seconds_bucket{manager=\"first\",le=\"+Inf\"} 10\n") != std::string::npos);
+    assert(response.find("gen_latency_seconds_count{manager=\"second\"}") == std::string::npos);
+
+    // families are not split by the second manager
+    assert(count_of(response, "# TYPE gen_dropped_total counter") == 1);
+    assert(count_of(response, "gen_dropped_total{") == 6);
+    size_t type = response.find("# TYPE gen_processed_total");
+    size_t next = response.find("# TYPE", type + 1);
+    assert(response.find("gen_processed_total{manager=\"second\"}") < next);
+
+    exporter.stop();
+    assert(scrape_unix_socket(path).empty());
+    first.stop();
+
+    Queue<int> backup(64);
+    second.save_session_data(backup);
+}
+
+void test_tracing()
+{
+    StaticResource container;
+    StaticHandler  handler;
+
+    BasicResourceManager<StaticResource, StaticHandler> x(
+        container,
+        handler,
+        16,
+        4
+    );
+    auto tracer = std::make_shared<Tracer>(10);
+    x.enable_tracing(tracer);
+
+    std::cout << "[+] Testing tracing" << std::endl;
+
+    x.start();
+
+    while (handler.popped < 1000);
+
+    x.stop();
+
+    std::ostringstream json;
+    tracer->write_json(json);
+    std::string trace = json.str();
+
+    assert(trace.find("\"traceEvents\"") != std::string::npos);
+    assert(trace.find("\"thread_name\"") != std::string::npos);
+    assert(trace.find("\"name\":\"receive\"") != std::string::npos);
+    assert(trace.find("\"ph\":\"b\",\"name\":\"queued\"") != std::string::npos);
+    assert(trace.find("\"ph\":\"X\",\"name\":\"process\"") != std::string::npos);
+
+    // the rings are drained by write_json
+    std::ostringstream again;
+    tracer->write_json(again);
+    assert(again.str().find("\"receive\"") == std::string::npos);
+}
+
+void test_lock_profiler()
+{
+    ProfiledMutex   mutex;
+    ProfiledCondVar cv;
+    mutex.set_name("test.lock");
+
+    std::cout << "[+] Testing lock profiler" << std::endl;
+
+    int counter = 0;
+    {
+        std::vector<std::jthread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&] {
+                for (int j = 0; j < 1000; ++j) {
+                    std::lock_guard<ProfiledMutex> guard(mutex);
+                    ++counter;
+                }
+                cv.notify_all();
+            });
+        }
+
+        std::unique_lock<ProfiledMutex> lock(mutex);
+        cv.wait(lock, [&] { return counter == 4000; });
+    }
+
+    LockStats& stats = LockProfiler::instance().stats("test.lock");
+    assert(stats.acquisitions >= 4001);
+    assert(stats.hold.count() == stats.acquisitions);
+    assert(stats.wait.count() == stats.contended);
+    assert(stats.hold.quantile(0.99) >= stats.hold.quantile(0.5));
+
+    std::ostringstream report;
+    LockProfiler::instance().report(report);
+    assert(report.str().find("test.lock") != std::string::npos);
+}
+
+struct PageResource
+{
+    int next = 0;
+
+    std::string get_data()
+    { return std::string(4096, static_cast<char>('a' + next++ % 26)); }
+
+    bool is_empty()
+    { return next >= 1000; }
+};
+
+// writes its pages into the recycled strings of the store
+struct PageFiller : PageResource
+{
+    std::atomic_int filled{0};
+
+    using PageResource::get_data;
+
+    void get_data(std::string& page)
+    {
+        page.assign(4096, static_cast<char>('a' + next++ % 26));
+        ++filled;
+    }
+};
+
+struct PageHandler
+{
+    std::atomic_long bytes{0};
+
+    void process(PayloadView<std::string> page)
+    { bytes += static_cast<long>(page->size()); }
+};
+
+void test_payloads()
+{
+    PayloadStore<std::string> store;
+
+    std::cout << "[+] Testing payload handles" << std::endl;
+
+    PayloadHandle first = store.put(std::string(4096, 'x'));
+    const char* buffer = store.get(first).data();
+    store.release(first);
+    assert(!store.valid(first));
+
+    // the released slot is refilled in place, keeping its buffer
+    PayloadHandle second = store.put_with([](std::string& s) { s.assign(100, 'y'); });
+    assert(second.index == first.index && second.generation != first.generation);
+    assert(store.get(second).data() == buffer);
+    assert(*store.view(second) == std::string(100, 'y'));
+    store.release(second);
+    store.release(second);
+    assert(store.size() == 0);
+
+    // racing releases of one handle recycle its slot once
+    for (int round = 0; round < 1000; ++round) {
+        PayloadHandle handle = store.put(std::string(16, 'z'));
+        std::vector<std::jthread> releasers;
+        for (int i = 0; i < 3; ++i) {
+            releasers.emplace_back([&] { store.release(handle); });
+        }
+        releasers.clear();
+        assert(store.size() == 0);
+    }
+    PayloadHandle a = store.put(std::string("a"));
+    PayloadHandle b = store.put(std::string("b"));
+    assert(a.index != b.index);
+    store.release(a);
+    store.release(b);
+
+    using resource_t = PayloadResource<PageResource>;
+    using handler_t = PayloadHandler<std::string, PageHandler>;
+
+    PageResource pages;
+    PageHandler  handler;
+    resource_t   resource(pages, store);
+    handler_t    page_handler(handler, store);
+
+    BasicResourceManager<resource_t, handler_t> x(
+        resource,
+        page_handler,
+        64,
+        4
+    );
+    x.start();
+    while (x.stats().processed < 1000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    x.stop();
+
+    assert(handler.bytes == 1000 * 4096);
+    assert(store.size() == 0);
+
+    PageFiller filler;
+    PageHandler filled_handler;
+    PayloadResource<PageFiller> filling_resource(filler, store);
+    PayloadHandler<std::string, PageHandler> filled_page_handler(filled_handler, store);
+
+    BasicResourceManager<PayloadResource<PageFiller>, PayloadHandler<std::string, PageHandler>> y(
+        filling_resource,
+        filled_page_handler,
+        64,
+        4
+    );
+    y.start();
+    while (y.stats().processed < 1000) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    y.stop();
+
+    assert(filler.filled == 1000);
+    assert(filled_handler.bytes == 1000 * 4096);
+    assert(store.size() == 0);
+}
+
+void test_generics()
+{
+    std::cout << "[INFO] GenericsTest is running..." << std::endl;
+
+    test_correct_multithreading(4);
+    test_correct_multithreading(8);
+    test_correct_multithreading(16);
+    test_correct_multithreading(32);
+    test_correct_multithreading(43);
+
+    test_static_dispatch(2);
+    test_static_dispatch(8);
+
+    test_coalescing();
+    test_submit();
+    test_stop_modes();
+    test_partitioning();
+    test_deadlines();
+    test_watchdog();
+    test_journal();
+    test_rate_limiting();
+    test_shared_executor();
+    test_autoscaling();
+    test_batching();
+    test_producers();
+    test_tuning();
+    test_spin_park();
+    test_monitoring();
+    test_byte_budget();
+    test_metrics();
+    test_tracing();
+    test_lock_profiler();
+    test_payloads();
+
+    std::cout << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <vector>
+
+#include "pipeline.h"
+
+using namespace gen;
+
+class CountingResource
+    : public Resource<int>
+{
+ public:
+    explicit CountingResource(int n)
+        : next_(0), n_(n)
+    { }
+
+    int get_data() override
+    { return next_++; }
+
+    bool is_empty() override
+    { return next_ >= n_; }
+
+ private:
+    int next_;
+    int n_;
+};
+
+class ToStringStage
+    : public DataHandler<int, std::string>
+{
+ public:
+    std::string process(int&& x) override
+    { return std::to_string(x); }
+};
+
+class SlowSink
+    : public DataHandler<std::string>
+{
+ public:
+    std::atomic_int received;
+    std::atomic_long total;
+
+    SlowSink()
+        : received(0), total(0)
+    { }
+
+    void process(std::string&& s) override
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        total += std::stol(s);
+        ++received;
+    }
+};
+
+void test_pipeline()
+{
+    std::cout << "[INFO] PipelineTest is running..." << std::endl;
+
+    // Test 1
+    {
+        CountingResource source(200);
+        ToStringStage    to_string;
+        SlowSink         sink;
+
+        Pipeline p = Pipeline::from<int>(source)
+            .then<std::string>("to_string", to_string, 4, 2)
+            .finish("sink", sink, 4, 3);
+
+        p.start();
+        while (sink.received < 200);
+        p.stop();
+
+        assert(sink.total == 199 * 200 / 2);
+
+        auto stats = p.stats();
+        assert(stats.size() == 2);
+        assert(stats[0].manager.processed == 200);
+        assert(stats[1].manager.processed == 200);
+        assert(stats[1].blocked_pushes > 0);
+
+        std::cout << "[+] Test 1 passed" << std::endl;
+    }
+
+    // Test 2
+    {
+        CountingResource source(100);
+        ToStringStage    to_string;
+        SlowSink         sink;
+
+        Pipeline p = Pipeline::from<int>(source)
+            .then<std::string>("to_string", to_string, 8, 2)
+            .finish("sink", sink, 8, 2);
+
+        p.start();
+        while (sink.received < 10);
+        p.save_session_data();
+
+        size_t saved = p.backup_size();
+        assert(sink.received + saved <= 100);
+
+        p.restore_session_data();
+        p.start();
+        while (sink.received < 100 - static_cast<int>(p.backup_size()));
+        p.save_session_data();
+
+        std::cout << "[+] Test 2 passed" << std::endl;
+    }
+
+    std::cout << "[OK] All tests passed\n" << std::endl;
+}
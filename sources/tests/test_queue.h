@@ -1,193 +1,276 @@
-#pragma once
-
-#include <iostream>
-#include <cassert>
-#include <vector>
-#include <string>
-
-#include "queue.h"
-
-using namespace gen;
-
-void test_queue()
-{
-    std::cout << "[INFO] QueueTest is running..." << std::endl;
-    // Test 1
-    {
-        Queue<int> q;
-        q.emplace(4);
-        q.emplace(6);
-        assert(q.take_first() == 4);
-        assert(q.back() == 6);
-        q.emplace(3);
-        assert(q.take_first() == 6);
-        q.pop();
-        assert(q.empty());
-
-        std::cout << "[+] Test 1 passed" << std::endl;
-    }
-
-    // Test 2
-    {
-        Queue<int> q;
-        q.emplace(1);
-        q.emplace(2);
-        q.emplace(3);
-        assert(q.take_first() == 1);
-        assert(q.front() == 2);
-        assert(q.back() == 3);
-
-        std::cout << "[+] Test 2 passed" << std::endl;
-    }
-
-    // Test 3
-    {
-        Queue<int> q, w;
-        q.emplace(1);
-        q.emplace(2);
-        w.emplace(4);
-
-        q = w;
-        q.pop();
-
-        assert(q.empty());
-        assert(!w.empty());
-
-        std::cout << "[+] Test 3 passed" << std::endl;
-    }
-
-    // Test 4
-    {
-        Queue<int> q;
-        q.emplace(4);
-        Queue<int> w(q);
-        w.pop();
-        assert(!q.empty());
-        w.emplace(3);
-        w.move_to(q);
-        assert(q.back() == 3 && q.size() == 2);
-        Queue<int> dq(std::move(q));
-        assert(dq.back() == 3);
-
-        std::cout << "[+] Test 4 passed" << std::endl;
-    }
-
-    // Test 5
-    {
-        auto q = new Queue<int>[10];
-        for (int i = 0; i < 1000; ++i)
-            q[i % 10].emplace(i);
-
-        for (int i = 999; i > 899; --i) {
-            assert(q[i % 10].take_first() == ((999 - i) / 10 * 10 + i % 10));
-            assert(q[i % 10].back() == (990 + i % 10));
-        }
-
-        for (int i = 0; i < 1000; ++i) {
-            q[i % 10].clear();
-            assert(q[i % 10].empty());
-        }
-
-        delete[] q;
-        std::cout << "[+] Test 5 passed" << std::endl;
-    }
-
-    // Test 6
-    {
-        auto q = new Queue<std::vector<int>>[10];
-        for (int k = 2; k; --k) {
-            for (int i = 0; i < 1000; ++i) {
-                std::vector<int> temp(1, i);
-                q[i % 10].emplace(temp);
-                assert(q[i % 10].back().back() == i);
-            }
-
-            for (int i = 999; i > 899; --i) {
-                assert(
-                    q[i % 10].take_first().back() == ((999 - i) / 10 * 10 + i % 10));
-                assert(q[i % 10].back().back() == (990 + i % 10));
-            }
-
-            for (int i = 0; i < 10; ++i) {
-                q[i].clear();
-                assert(q[i].empty());
-            }
-        }
-
-        delete[] q;
-        std::cout << "[+] Test 6 passed" << std::endl;
-    }
-
-    // Test 7
-    {
-        Queue<std::string> q;
-        q.emplace("first");
-        q.emplace("second");
-        Queue<std::string> w(q);
-
-        assert(q.front() != q.back());
-        assert(q.front() == "first");
-        assert(q.back() == "second");
-        q.clear();
-
-        std::string_view s = "safe";
-        q.emplace(std::string(s));
-        assert(s == "safe");
-
-        std::cout << "[+] Test 7 passed" << std::endl;
-    }
-
-    // Test 8
-    {
-        Queue<int> q = {1, 2, 3, 4, 5};
-
-        Queue<int> w = {2};
-        w.move_to(q);
-        assert(q.back() == 2 && q.size() == 6);
-
-        q.move_to(w);
-        assert(q.empty());
-        assert(w.size() == 6);
-
-        while (!w.empty())
-            w.pop();
-
-        std::cout << "[+] Test 8 passed" << std::endl;
-    }
-
-    // Test 9
-    {
-        Queue<int> q = {1, 2, 3, 4, 5};
-        int i = 1;
-        for (auto x : q) {
-            assert(x == i);
-            ++i;
-        }
-
-        std::cout << "[+] Test 9 passed" << std::endl;
-    }
-
-    // Test 10
-    {
-        Queue<std::vector<int>> w;
-
-        for (int i = 0; i < 8; ++i)
-            w.emplace(40);
-
-        // do not use emplace in such cases
-        w.push(w.front());
-        assert(w.front() == w.back());
-
-        Queue<int> q = {1, 2, 3, 4, 5, 6, 7, 8};
-        q.push(q.back());
-
-        // there is no moving
-        q.push(std::move(q.front()));
-        assert(q.take_first() == q.back());
-        assert(q.size() == 9);
-
-        std::cout << "[+] Test 10 passed" << std::endl;
-    }
-
-    std::cout << "[OK] All tests passed\n" << std::endl;
+#pragma once
+
+#include <iostream>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <thread>
+
+#include "queue.h"
+#include "producer.h"
+
+using namespace gen;
+
+void test_queue()
+{
+    std::cout << "[INFO] QueueTest is running..." << std::endl;
+    // Test 1
+    {
+        Queue<int> q;
+        q.emplace(4);
+        q.emplace(6);
+        assert(q.take_first() == 4);
+        assert(q.back() == 6);
+        q.emplace(3);
+        assert(q.take_first() == 6);
+        q.pop();
+        assert(q.empty());
+
+        std::cout << "[+] Test 1 passed" << std::endl;
+    }
+
+    // Test 2
+    {
+        Queue<int> q;
+        q.emplace(1);
+        q.emplace(2);
+        q.emplace(3);
+        assert(q.take_first() == 1);
+        assert(q.front() == 2);
+        assert(q.back() == 3);
+
+        std::cout << "[+] Test 2 passed" << std::endl;
+    }
+
+    // Test 3
+    {
+        Queue<int> q, w;
+        q.emplace(1);
+        q.emplace(2);
+        w.emplace(4);
+
+        q = w;
+        q.pop();
+
+        assert(q.empty());
+        assert(!w.empty());
+
+        std::cout << "[+] Test 3 passed" << std::endl;
+    }
+
+    // Test 4
+    {
+        Queue<int> q;
+        q.emplace(4);
+        Queue<int> w(q);
+        w.pop();
+        assert(!q.empty());
+        w.emplace(3);
+        w.move_to(q);
+        assert(q.back() == 3 && q.size() == 2);
+        Queue<int> dq(std::move(q));
+        assert(dq.back() == 3);
+
+        std::cout << "[+] Test 4 passed" << std::endl;
+    }
+
+    // Test 5
+    {
+        auto q = new Queue<int>[10];
+        for (int i = 0; i < 1000; ++i)
+            q[i % 10].emplace(i);
+
+        for (int i = 999; i > 899; --i) {
+            assert(q[i % 10].take_first() == ((999 - i) / 10 * 10 + i % 10));
+            assert(q[i % 10].back() == (990 + i % 10));
+        }
+
+        for (int i = 0; i < 1000; ++i) {
+            q[i % 10].clear();
+            assert(q[i % 10].empty());
+        }
+
+        delete[] q;
+        std::cout << "[+] Test 5 passed" << std::endl;
+    }
+
+    // Test 6
+    {
+        auto q = new Queue<std::vector<int>>[10];
+        for (int k = 2; k; --k) {
+            for (int i = 0; i < 1000; ++i) {
+                std::vector<int> temp(1, i);
+                q[i % 10].emplace(temp);
+                assert(q[i % 10].back().back() == i);
+            }
+
+            for (int i = 999; i > 899; --i) {
+                assert(
+                    q[i % 10].take_first().back() == ((999 - i) / 10 * 10 + i % 10));
+                assert(q[i % 10].back().back() == (990 + i % 10));
+            }
+
+            for (int i = 0; i < 10; ++i) {
+                q[i].clear();
+                assert(q[i].empty());
+            }
+        }
+
+        delete[] q;
+        std::cout << "[+] Test 6 passed" << std::endl;
+    }
+
+    // Test 7
+    {
+        Queue<std::string> q;
+        q.emplace("first");
+        q.emplace("second");
+        Queue<std::string> w(q);
+
+        assert(q.front() != q.back());
+        assert(q.front() == "first");
+        assert(q.back() == "second");
+        q.clear();
+
+        std::string_view s = "safe";
+        q.emplace(std::string(s));
+        assert(s == "safe");
+
+        std::cout << "[+] Test 7 passed" << std::endl;
+    }
+
+    // Test 8
+    {
+        Queue<int> q = {1, 2, 3, 4, 5};
+
+        Queue<int> w = {2};
+        w.move_to(q);
+        assert(q.back() == 2 && q.size() == 6);
+
+        q.move_to(w);
+        assert(q.empty());
+        assert(w.size() == 6);
+
+        while (!w.empty())
+            w.pop();
+
+        std::cout << "[+] Test 8 passed" << std::endl;
+    }
+
+    // Test 9
+    {
+        Queue<int> q = {1, 2, 3, 4, 5};
+        int i = 1;
+        for (auto x : q) {
+            assert(x == i);
+            ++i;
+        }
+
+        std::cout << "[+] Test 9 passed" << std::endl;
+    }
+
+    // Test 10
+    {
+        Queue<std::vector<int>> w;
+
+        for (int i = 0; i < 8; ++i)
+            w.emplace(40);
+
+        // do not use emplace in such cases
+        w.push(w.front());
+        assert(w.front() == w.back());
+
+        Queue<int> q = {1, 2, 3, 4, 5, 6, 7, 8};
+        q.push(q.back());
+
+        // there is no moving
+        q.push(std::move(q.front()));
+        assert(q.take_first() == q.back());
+        assert(q.size() == 9);
+
+        std::cout << "[+] Test 10 passed" << std::endl;
+    }
+
+    // Test 11
+    {
+        Queue<int> q(16);
+        for (int i = 0; i < 10000; ++i)
+            q.emplace(i);
+        assert(q.max_size() >= 10000);
+
+        for (int i = 0; i < 9990; ++i)
+            assert(q.take_first() == i);
+        assert(q.max_size() < 64 && q.max_size() >= 16);
+        assert(q.front() == 9990 && q.back() == 9999);
+
+        q.emplace(10000);
+        q.shrink_to_fit();
+        assert(q.max_size() == 16 && q.size() == 11);
+
+        Queue<int> w(q);
+        assert(w.take_first() == 9990 && w.back() == 10000);
+
+        std::cout << "[+] Test 11 passed" << std::endl;
+    }
+
+    // Test 12
+    {
+        Queue<std::string> q;
+        q.emplace("a");
+        std::vector<std::string> items(100, "b");
+        q.push_all(items);
+        assert(items.empty());
+        assert(q.size() == 101 && q.max_size() == 128);
+        assert(q.take_first() == "a" && q.front() == "b");
+
+        Queue<int> w;
+        {
+            BufferedProducer<int> producer(w, ProducerPolicy{32});
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t) {
+                threads.emplace_back([&producer, t] {
+                    for (int i = 0; i < 1000; ++i)
+                        producer.push(t * 10000 + i);
+                });
+            }
+            for (auto& t : threads)
+                t.join();
+            assert(producer.pushed() == 4000);
+            assert(producer.flushes() < 4000);
+        }
+        assert(w.size() == 4000);
+
+        // elements of one thread stay in order
+        int last[4] = {-1, -1, -1, -1};
+        for (int x : w) {
+            assert(x % 10000 > last[x / 10000]);
+            last[x / 10000] = x % 10000;
+        }
+
+        std::cout << "[+] Test 12 passed" << std::endl;
+    }
+
+    // Test 13
+    {
+        // pop() shrinks the ring under the lock emplace() takes
+        Queue<int> q;
+        std::thread producer([&q] {
+            for (int i = 0; i < 100000; ++i)
+                q.emplace(i);
+        });
+
+        int popped = 0;
+        while (popped < 100000) {
+            if (!q.empty()) {
+                q.pop();
+                ++popped;
+            }
+        }
+        producer.join();
+        assert(q.empty() && q.max_size() == 8);
+
+        std::cout << "[+] Test 13 passed" << std::endl;
+    }
+
+    std::cout << "[OK] All tests passed\n" << std::endl;
 }
\ No newline at end of file
@@ -1,74 +1,131 @@
-#pragma once
-
-#include <iostream>
-#include <thread>
-
-#include "progress_bar.h"
-#include "echo_server.h"
-
-using namespace server;
-
-void test_server()
-{
-    std::cout << "[INFO] ServerTest is running..." << std::endl;
-
-    ProgressBar bar(100);
-
-    BDRequestCounter checker{};
-    EchoServer& server = GetEchoServer(checker);
-
-    std::cout << "[+] Launching server..." << std::endl;
-
-    server.start();
-
-    std::cout << "[+] Server is running, wait a minute..." << std::endl;
-
-    for (int i = 0; i < 100; ++i) {
-        bar.make_progress();
-        bar.update();
-        std::this_thread::sleep_for(std::chrono::milliseconds(600));
-    }
-
-    std::cout << std::endl << "[+] Stopping server..." << std::endl;
-
-    server.stop();
-
-    std::cout << "[+] Server stopped normally" << std::endl;
-
-    std::cout << "[+] " << checker.get_all_ignored()
-              << " request(s) are pending" << std::endl;
-
-    bar.assign(100);
-
-    std::cout << "[+] Restarting server..." << std::endl;
-
-    server.restart();
-
-    std::cout << "[+] Server is running, wait a minute..." << std::endl;
-
-    for (int i = 0; i < 100; ++i) {
-        bar.make_progress();
-        bar.update();
-        std::this_thread::sleep_for(std::chrono::milliseconds(600));
-    }
-
-    std::cout << std::endl << "[+] Shutdown server..." << std::endl;
-
-    server.shutdown();
-
-    std::cout << "[+] Server shutdown normally" << std::endl;
-
-    std::cout << "[!] " << checker.get_all() - checker.get_all_ignored()
-              << " request(s) have been processed, "
-              << server.get_backup_size()
-              << " saved, "
-              << checker.get_all_ignored() - server.get_backup_size()
-              << " ignored\n";
-
-    if (checker.get_all_ignored() - server.get_backup_size()) {
-        std::cerr << "[-] Test failed.\n" << std::endl;
-    }
-    else {
-        std::cout << "[OK] Test passed\n" << std::endl;
-    }
+#pragma once
+
+#include <iostream>
+#include <cassert>
+#include <thread>
+
+#include <unistd.h>
+
+#include "progress_bar.h"
+#include "echo_server.h"
+#include "request_parser.h"
+
+using namespace server;
+
+void test_request_parser()
+{
+    RequestParser parser;
+
+    std::cout << "[+] Testing request parser (" << parser.isa() << ")" << std::endl;
+
+    assert(classify_verb("GET", 3) == VERB_GET);
+    assert(classify_verb("POST /a", 7) == VERB_POST);
+    assert(classify_verb("DELETE\r", 7) == VERB_DELETE);
+    assert(classify_verb("PUTS", 4) == VERB_UNKNOWN);
+    assert(classify_verb("GE", 2) == VERB_UNKNOWN);
+    assert(classify(BDRequest("PUT", 0)) == VERB_PUT);
+
+    // long enough for the vector loops and their tails
+    std::string buffer;
+    const char* lines[] = {"GET /a", "PUT /b\r", "", "POST", "DELETE /a/very/long/key/name", "HEAD /"};
+    for (int i = 0; i < 20; ++i) {
+        for (const char* line : lines) {
+            buffer += line;
+            buffer += '\n';
+        }
+    }
+    buffer += "GET /partial";
+
+    std::vector<BDRequest> requests;
+    size_t consumed = parser.parse(buffer, requests);
+    assert(consumed == buffer.size() - 12);
+    assert(requests.size() == 100);
+
+    const Verb verbs[] = {VERB_GET, VERB_PUT, VERB_POST, VERB_DELETE, VERB_UNKNOWN};
+    for (size_t i = 0; i < requests.size(); ++i) {
+        assert(requests[i].verb() == verbs[i % 5]);
+        assert(requests[i].getData().id == i + 1);
+    }
+    assert(requests[1].getData().txt == "PUT /b");
+
+    // the partial line completes in the next buffer
+    std::string rest = buffer.substr(consumed) + "\n";
+    assert(parser.parse(rest, requests) == rest.size());
+    assert(requests.back().getData().txt == "GET /partial");
+    assert(requests.back().getData().id == 101);
+}
+
+void test_server()
+{
+    std::cout << "[INFO] ServerTest is running..." << std::endl;
+
+    ProgressBar bar(100);
+
+    BDRequestCounter checker{};
+    EchoServer& server = GetEchoServer(checker);
+
+    gen::MetricsExporter exporter("/tmp/echo_metrics_" + std::to_string(getpid()) + ".sock");
+    server.export_metrics(exporter);
+    exporter.start();
+
+    std::cout << "[+] Launching server..." << std::endl;
+
+    server.start();
+
+    std::cout << "[+] Server is running, wait a minute..." << std::endl;
+
+    for (int i = 0; i < 100; ++i) {
+        bar.make_progress();
+        bar.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    }
+
+    std::string metrics = exporter.scrape();
+    assert(metrics.find("echo_requests_total ") != std::string::npos);
+    assert(metrics.find("gen_latency_seconds_count{manager=\"echo\"}") != std::string::npos);
+
+    std::cout << std::endl << "[+] Stopping server..." << std::endl;
+
+    server.stop();
+
+    std::cout << "[+] Server stopped normally" << std::endl;
+
+    std::cout << "[+] " << checker.get_all_ignored()
+              << " request(s) are pending" << std::endl;
+
+    bar.assign(100);
+
+    std::cout << "[+] Restarting server..." << std::endl;
+
+    server.restart();
+
+    std::cout << "[+] Server is running, wait a minute..." << std::endl;
+
+    for (int i = 0; i < 100; ++i) {
+        bar.make_progress();
+        bar.update();
+        std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    }
+
+    std::cout << std::endl << "[+] Shutdown server..." << std::endl;
+
+    server.shutdown();
+
+    std::cout << "[+] Server shutdown normally" << std::endl;
+
+    exporter.stop();
+
+    std::cout << "[!] " << checker.get_all() - checker.get_all_ignored()
+              << " request(s) have been processed, "
+              << server.get_backup_size()
+              << " saved, "
+              << checker.get_all_ignored() - server.get_backup_size()
+              << " ignored\n";
+
+    if (checker.get_all_ignored() - server.get_backup_size()) {
+        std::cerr << "[-] Test failed.\n" << std::endl;
+    }
+    else {
+        std::cout << "[OK] Test passed\n" << std::endl;
+    }
 }
\ No newline at end of file
@@ -1,37 +1,74 @@
-#pragma once
-
-#include <iostream>
-
-#ifdef QUEUE_TEST
-#include "test_queue.h"
-#endif  // QUEUE_TEST
-
-#ifdef GENERICS_TEST
-#include "test_generics.h"
-#endif  // GENERICS_TEST
-
-#ifdef SERVER_TEST
-#include "test_server.h"
-#endif  // SERVER_TEST
-
-void RUN_ALL_TESTS() {
-    std::cout << "[INFO] Looking up for tests...\n" << std::endl;
-
-#ifdef QUEUE_TEST
-    std::cout << "[INFO] + Found test: QueueTest" << std::endl;
-    test_queue();
-#endif
-
-#ifdef GENERICS_TEST
-    std::cout << "[INFO] + Found test: GenericsTest" << std::endl;
-    test_generics();
-#endif
-
-#ifdef SERVER_TEST
-    std::cout << "[INFO] + Found test: ServerTest\n";
-    test_server();
-#endif
-
-    std::this_thread::sleep_for(std::chrono::milliseconds(500));
-    std::cout << "[INFO] No more tests\n";
+#pragma once
+
+#include <iostream>
+
+#ifdef QUEUE_TEST
+#include "test_queue.h"
+#endif  // QUEUE_TEST
+
+#ifdef GENERICS_TEST
+#include "test_generics.h"
+#endif  // GENERICS_TEST
+
+#ifdef PIPELINE_TEST
+#include "test_pipeline.h"
+#endif  // PIPELINE_TEST
+
+#ifdef SHM_TEST
+#include "test_shm.h"
+#endif  // SHM_TEST
+
+#ifdef SERVER_TEST
+#include "test_server.h"
+#endif  // SERVER_TEST
+
+#ifdef WAKEUP_BENCH
+#include "bench_wakeup.h"
+#endif  // WAKEUP_BENCH
+
+#ifdef TUNING_BENCH
+#include "bench_tuning.h"
+#endif  // TUNING_BENCH
+
+void RUN_ALL_TESTS() {
+    std::cout << "[INFO] Looking up for tests...\n" << std::endl;
+
+#ifdef QUEUE_TEST
+    std::cout << "[INFO] + Found test: QueueTest" << std::endl;
+    test_queue();
+#endif
+
+#ifdef GENERICS_TEST
+    std::cout << "[INFO] + Found test: GenericsTest" << std::endl;
+    test_generics();
+#endif
+
+#ifdef PIPELINE_TEST
+    std::cout << "[INFO] + Found test: PipelineTest" << std::endl;
+    test_pipeline();
+#endif
+
+#ifdef SHM_TEST
+    std::cout << "[INFO] + Found test: ShmTest" << std::endl;
+    test_shm();
+#endif
+
+#ifdef SERVER_TEST
+    std::cout << "[INFO] + Found test: ServerTest\n";
+    test_request_parser();
+    test_server();
+#endif
+
+#ifdef WAKEUP_BENCH
+    std::cout << "[INFO] + Found benchmark: WakeupBench" << std::endl;
+    bench_wakeup();
+#endif
+
+#ifdef TUNING_BENCH
+    std::cout << "[INFO] + Found benchmark: TuningBench" << std::endl;
+    bench_tuning();
+#endif
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    std::cout << "[INFO] No more tests\n";
 }
\ No newline at end of file